@@ -0,0 +1,816 @@
+// Dataset reader library for hex_gen_data output, see hex_reader.h.
+
+#define HEX_READER_BUILD
+#include "hex_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// HEX_READER_SIMD builds AVX2 and AVX-512 variants of the parsing and unpacking kernels next to
+// the scalar code, whatever the target flags; the CPU picks one set at run time
+#if defined(HEX_READER_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define HEX_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define HEX_TARGET(isa)  // MSVC compiles intrinsics of any ISA without flags
+#else
+#define HEX_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// .hxb layout, kept in sync with BinaryDatasetHeader in main.cpp
+const char BINARY_DATASET_MAGIC[8] = {'H', 'E', 'X', 'B', 'R', 'E', 'C', '1'};
+
+struct BinaryDatasetHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t board_dim;
+    uint32_t record_size;
+    uint32_t header_size;
+    uint64_t record_count;
+    uint64_t seed;
+    uint64_t reserved[3];
+};
+
+static_assert(sizeof(BinaryDatasetHeader) == 64, "BinaryDatasetHeader layout changed");
+
+const int MAX_BOARD_CELLS = 256;  // PackedBoard holds boards up to 16x16
+
+thread_local std::string last_error;
+
+uint32_t plane_bytes_for(int board_dim) {
+    return (board_dim * board_dim + 7) / 8;
+}
+
+uint32_t record_size_for(int board_dim) {
+    return (2 * plane_bytes_for(board_dim) + 3 + 7) / 8 * 8;
+}
+
+// Read-only view of a whole file
+class MappedFile {
+public:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    ~MappedFile() {
+        unmap();
+    }
+
+    bool map(const std::string &path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(file, &file_size);
+        size = static_cast<size_t>(file_size.QuadPart);
+        if (size == 0) {
+            return true;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            return false;
+        }
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return data != nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size = info.st_size;
+        if (size == 0) {
+            ::close(fd);
+            return true;
+        }
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const uint8_t*>(mapped);
+        return true;
+#endif
+    }
+
+    // Ask the OS to start reading [offset, offset + length) and fault it in
+    void prefetch(size_t offset, size_t length) const {
+        if (data == nullptr || offset >= size) {
+            return;
+        }
+        length = std::min(length, size - offset);
+#ifndef _WIN32
+        size_t page = 4096;
+        size_t start = offset & ~(page - 1);
+        madvise(const_cast<uint8_t*>(data) + start, length + (offset - start), MADV_WILLNEED);
+#endif
+        volatile uint8_t sink = 0;
+        for (size_t p = offset; p < offset + length; p += 4096) {
+            sink += data[p];
+        }
+        (void)sink;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+    void unmap() {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data != nullptr) {
+            munmap(const_cast<uint8_t*>(data), size);
+        }
+#endif
+        data = nullptr;
+    }
+};
+
+// Vectorized kernels. Each set parses or unpacks the leading cells of a board in whole vector
+// blocks and returns the first cell it left to the scalar loop of its caller, so the scalar set
+// simply returns 0. The avx2 set needs AVX2 and BMI2, the avx512 set AVX-512 F and BW as well.
+struct KernelSet {
+    const char *name;
+    int (*string_cells)(const char *p, int cells, uint8_t *record, uint32_t plane);
+    // Advances p past the cells it parsed
+    int (*coord_cells)(const char *&p, const char *end, int cells, uint8_t *record, uint32_t plane);
+    int (*unpack_int8)(const uint8_t *x_plane, const uint8_t *o_plane, int cells, int8_t *out);
+    int (*widen_float32)(const int8_t *values, int cells, float *out);
+};
+
+int scalar_string_cells(const char *, int, uint8_t *, uint32_t) {
+    return 0;
+}
+
+int scalar_coord_cells(const char *&, const char *, int, uint8_t *, uint32_t) {
+    return 0;
+}
+
+int scalar_unpack_int8(const uint8_t *, const uint8_t *, int, int8_t *) {
+    return 0;
+}
+
+int scalar_widen_float32(const int8_t *, int, float *) {
+    return 0;
+}
+
+const KernelSet SCALAR_KERNELS = {"scalar", scalar_string_cells, scalar_coord_cells, scalar_unpack_int8,
+                                  scalar_widen_float32};
+
+#ifdef HEX_KERNELS_X86
+inline int popcount32(uint32_t value) {
+#ifdef _MSC_VER
+    return __popcnt(value);
+#else
+    return __builtin_popcount(value);
+#endif
+}
+
+// Index of the highest set bit, value must be nonzero
+inline int highest_bit(uint32_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return index;
+#else
+    return 31 - __builtin_clz(value);
+#endif
+}
+
+// OR count bits into a bit plane starting at cell
+inline void deposit_bits(uint8_t *plane, int cell, uint64_t bits) {
+    bits <<= cell & 7;
+    for (uint8_t *byte = plane + (cell >> 3); bits != 0; ++byte, bits >>= 8) {
+        *byte |= static_cast<uint8_t>(bits);
+    }
+}
+
+// Bits of the 32 bytes at p equal to c
+HEX_TARGET("avx2") inline uint32_t match_mask(const char *p, char c) {
+    __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(c))));
+}
+
+// Spread 32 bits over 32 bytes, 0xFF where the bit is set
+HEX_TARGET("avx2") inline __m256i expand_bits(uint32_t bits) {
+    const __m256i byte_select = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bit_select = _mm256_set1_epi64x(static_cast<long long>(0x8040201008040201ULL));
+    __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(bits)), byte_select);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bit_select), bit_select);
+}
+
+// One character per cell, so 32 cells map straight onto 32 mask bits
+HEX_TARGET("avx2") int avx2_string_cells(const char *p, int cells, uint8_t *record, uint32_t plane) {
+    int cell = 0;
+    for (; cell + 32 <= cells; cell += 32) {
+        uint32_t x_bits = match_mask(p + cell, 'X');
+        uint32_t o_bits = match_mask(p + cell, 'O');
+        std::memcpy(record + cell / 8, &x_bits, sizeof(x_bits));
+        std::memcpy(record + plane + cell / 8, &o_bits, sizeof(o_bits));
+    }
+    return cell;
+}
+
+// Cells are "0", "1" or "-1", each followed by a comma: the character before a comma tells
+// whether the cell holds a stone and a '-' two before it makes it an O stone. Each block
+// starts at a cell boundary and ends after the last comma it contains.
+HEX_TARGET("avx2,bmi2") int avx2_coord_cells(const char *&p, const char *end, int cells, uint8_t *record, uint32_t plane) {
+    int cell = 0;
+    while (cell < cells && end - p >= 32) {
+        uint32_t commas = match_mask(p, ',');
+        for (int extra = popcount32(commas) - (cells - cell); extra > 0; --extra) {
+            commas &= ~(1u << highest_bit(commas));  // Only commas ending board cells
+        }
+        if (commas == 0) {
+            break;
+        }
+        uint32_t stone = (match_mask(p, '1') << 1) & commas;
+        uint32_t o_stone = (match_mask(p, '-') << 2) & commas;
+        deposit_bits(record, cell, _pext_u32(stone & ~o_stone, commas));
+        deposit_bits(record + plane, cell, _pext_u32(o_stone, commas));
+        cell += popcount32(commas);
+        p += highest_bit(commas) + 1;
+    }
+    return cell;
+}
+
+HEX_TARGET("avx2") int avx2_unpack_int8(const uint8_t *x_plane, const uint8_t *o_plane, int cells, int8_t *out) {
+    int cell = 0;
+    for (; cell + 32 <= cells; cell += 32) {
+        uint32_t x_bits, o_bits;
+        std::memcpy(&x_bits, x_plane + cell / 8, sizeof(x_bits));
+        std::memcpy(&o_bits, o_plane + cell / 8, sizeof(o_bits));
+        // The masks are -1 where set, so O - X gives 1 for X and -1 for O
+        __m256i values = _mm256_sub_epi8(expand_bits(o_bits), expand_bits(x_bits));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + cell), values);
+    }
+    return cell;
+}
+
+HEX_TARGET("avx2") int avx2_widen_float32(const int8_t *values, int cells, float *out) {
+    int cell = 0;
+    for (; cell + 8 <= cells; cell += 8) {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(values + cell));
+        _mm256_storeu_ps(out + cell, _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes)));
+    }
+    return cell;
+}
+
+const KernelSet AVX2_KERNELS = {"avx2", avx2_string_cells, avx2_coord_cells, avx2_unpack_int8, avx2_widen_float32};
+
+// The AVX-512 set works on 64 cells at a time and hands shorter remainders to the AVX2 kernels.
+// Variable-width coord rows and the float conversion, bound by stores, keep the AVX2 kernels.
+HEX_TARGET("avx2,avx512f,avx512bw") int avx512_string_cells(const char *p, int cells, uint8_t *record, uint32_t plane) {
+    int cell = 0;
+    for (; cell + 64 <= cells; cell += 64) {
+        __m512i chars = _mm512_loadu_si512(p + cell);
+        uint64_t x_bits = _mm512_cmpeq_epi8_mask(chars, _mm512_set1_epi8('X'));
+        uint64_t o_bits = _mm512_cmpeq_epi8_mask(chars, _mm512_set1_epi8('O'));
+        std::memcpy(record + cell / 8, &x_bits, sizeof(x_bits));
+        std::memcpy(record + plane + cell / 8, &o_bits, sizeof(o_bits));
+    }
+    return cell + avx2_string_cells(p + cell, cells - cell, record + cell / 8, plane);
+}
+
+HEX_TARGET("avx2,avx512f,avx512bw") int avx512_unpack_int8(const uint8_t *x_plane, const uint8_t *o_plane, int cells,
+                                                            int8_t *out) {
+    int cell = 0;
+    for (; cell + 64 <= cells; cell += 64) {
+        uint64_t x_bits, o_bits;
+        std::memcpy(&x_bits, x_plane + cell / 8, sizeof(x_bits));
+        std::memcpy(&o_bits, o_plane + cell / 8, sizeof(o_bits));
+        __m512i values = _mm512_sub_epi8(_mm512_movm_epi8(o_bits), _mm512_movm_epi8(x_bits));
+        _mm512_storeu_si512(out + cell, values);
+    }
+    return cell + avx2_unpack_int8(x_plane + cell / 8, o_plane + cell / 8, cells - cell, out + cell);
+}
+
+const KernelSet AVX512_KERNELS = {"avx512", avx512_string_cells, avx2_coord_cells, avx512_unpack_int8,
+                                  avx2_widen_float32};
+
+// Features the kernel sets need, including OS support for saving the wider registers
+bool cpu_has_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0x6) != 0x6) {  // OSXSAVE, XMM and YMM state
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0 && (info[1] & (1 << 8)) != 0;  // AVX2, BMI2
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
+#endif
+}
+
+bool cpu_has_avx512() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuidex(info, 7, 0);
+    return cpu_has_avx2() && (_xgetbv(0) & 0xE6) == 0xE6 &&  // Opmask and ZMM state
+           (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;  // AVX-512 F, BW
+#else
+    return cpu_has_avx2() && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+}
+#endif
+
+// Kernel set by name, or nullptr if it is unknown or this CPU cannot run it
+const KernelSet *find_kernels(const std::string &name) {
+#ifdef HEX_KERNELS_X86
+    if (name == "avx512" && cpu_has_avx512()) {
+        return &AVX512_KERNELS;
+    }
+    if (name == "avx2" && cpu_has_avx2()) {
+        return &AVX2_KERNELS;
+    }
+#endif
+    return name == "scalar" ? &SCALAR_KERNELS : nullptr;
+}
+
+// The widest set the CPU supports, unless HEX_READER_ISA names another
+const KernelSet *best_kernels() {
+    const char *requested = std::getenv("HEX_READER_ISA");
+    if (requested != nullptr && *requested != '\0' && std::string(requested) != "auto") {
+        if (const KernelSet *kernels = find_kernels(requested)) {
+            return kernels;
+        }
+    }
+    for (const char *name : {"avx512", "avx2"}) {
+        if (const KernelSet *kernels = find_kernels(name)) {
+            return kernels;
+        }
+    }
+    return &SCALAR_KERNELS;
+}
+
+std::atomic<const KernelSet*> selected_kernels{nullptr};
+
+// Selected on first use, or by hex_reader_select_isa
+const KernelSet &active_kernels() {
+    const KernelSet *kernels = selected_kernels.load(std::memory_order_acquire);
+    if (kernels == nullptr) {
+        const KernelSet *best = best_kernels();
+        selected_kernels.compare_exchange_strong(kernels, best, std::memory_order_acq_rel);
+        kernels = selected_kernels.load(std::memory_order_acquire);
+    }
+    return *kernels;
+}
+
+// Parse one CSV data line into a packed record; false for lines that hold no game, such as the
+// stray starting_player,winner lines of old string files
+bool parse_csv_line(const char *line, const char *end, bool string_format, int board_dim, uint8_t *record) {
+    const KernelSet &kernels = active_kernels();
+    int cells = board_dim * board_dim;
+    uint32_t plane = plane_bytes_for(board_dim);
+    std::memset(record, 0, record_size_for(board_dim));
+    const char *p = line;
+    if (string_format) {
+        const char *comma = static_cast<const char*>(std::memchr(p, ',', end - p));
+        if (comma == nullptr || comma - p != cells) {
+            return false;
+        }
+        for (int cell = kernels.string_cells(p, cells, record, plane); cell < cells; ++cell) {
+            record[cell >> 3] |= (p[cell] == 'X') << (cell & 7);
+            record[plane + (cell >> 3)] |= (p[cell] == 'O') << (cell & 7);
+        }
+        p = comma + 1;
+    } else {
+        for (int cell = kernels.coord_cells(p, end, cells, record, plane); cell < cells; ++cell) {
+            if (p >= end) {
+                return false;
+            }
+            if (*p == '-') {
+                record[plane + (cell >> 3)] |= 1 << (cell & 7);
+                p += 2;
+            } else {
+                record[cell >> 3] |= (*p == '1') << (cell & 7);
+                p += 1;
+            }
+            p++;  // Comma
+        }
+    }
+
+    // starting_player,winner follow the board; old string files only had the winner
+    int values[2];
+    int count = 0;
+    while (p < end && count < 2) {
+        values[count++] = std::atoi(p);
+        const char *comma = static_cast<const char*>(std::memchr(p, ',', end - p));
+        p = comma == nullptr ? end : comma + 1;
+    }
+    if (count == 0) {
+        return false;
+    }
+    record[2 * plane] = static_cast<uint8_t>(count == 2 ? values[0] : -1);
+    record[2 * plane + 1] = static_cast<uint8_t>(values[count - 1]);
+    return true;
+}
+
+// Parse a dataset CSV into packed records, splitting the rows over threads at line boundaries
+bool parse_csv(const MappedFile &file, int threads, int &board_dim, std::vector<uint8_t> &records) {
+    const char *data = reinterpret_cast<const char*>(file.data);
+    const char *end = data + file.size;
+    const char *header_end = static_cast<const char*>(std::memchr(data, '\n', file.size));
+    if (header_end == nullptr) {
+        last_error = "no CSV header line";
+        return false;
+    }
+    std::string header(data, header_end);
+    bool string_format = header.rfind("board,", 0) == 0;
+    const char *rows = header_end + 1;
+    int dim = 0;
+    if (string_format) {
+        const char *comma = static_cast<const char*>(std::memchr(rows, ',', end - rows));
+        int cells = comma != nullptr ? static_cast<int>(comma - rows) : 0;
+        while ((dim + 1) * (dim + 1) <= cells) {
+            dim++;
+        }
+    } else {
+        size_t label = header.find("starting_player");
+        int cells = std::count(header.begin(), header.begin() + (label == std::string::npos ? 0 : label), ',');
+        while ((dim + 1) * (dim + 1) <= cells) {
+            dim++;
+        }
+    }
+    if (dim == 0 || dim * dim > MAX_BOARD_CELLS || (board_dim != 0 && board_dim != dim)) {
+        last_error = "unrecognised or mismatched CSV board size";
+        return false;
+    }
+    board_dim = dim;
+
+    threads = std::max(1, std::min<int>(threads, static_cast<int>((end - rows) / (1 << 20)) + 1));
+    std::vector<const char*> bounds(threads + 1, end);
+    bounds[0] = rows;
+    for (int t = 1; t < threads; ++t) {
+        const char *split = std::max(bounds[t - 1], rows + (end - rows) * t / threads);
+        const char *newline = static_cast<const char*>(std::memchr(split, '\n', end - split));
+        bounds[t] = newline == nullptr ? end : newline + 1;
+    }
+
+    uint32_t record_size = record_size_for(dim);
+    std::vector<std::vector<uint8_t>> parsed(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::vector<uint8_t> &out = parsed[t];
+            std::vector<uint8_t> record(record_size);
+            for (const char *line = bounds[t]; line < bounds[t + 1];) {
+                const char *newline = static_cast<const char*>(std::memchr(line, '\n', bounds[t + 1] - line));
+                const char *line_end = newline == nullptr ? bounds[t + 1] : newline;
+                const char *content_end = (line_end > line && line_end[-1] == '\r') ? line_end - 1 : line_end;
+                if (parse_csv_line(line, content_end, string_format, dim, record.data())) {
+                    out.insert(out.end(), record.begin(), record.end());
+                }
+                line = line_end + 1;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& part : parsed) {
+        records.insert(records.end(), part.begin(), part.end());
+    }
+    return true;
+}
+
+// Bit planes to one int8 per cell: 1 for X, -1 for O
+void unpack_int8(const uint8_t *x_plane, const uint8_t *o_plane, int cells, int8_t *out) {
+    for (int cell = active_kernels().unpack_int8(x_plane, o_plane, cells, out); cell < cells; ++cell) {
+        int x = (x_plane[cell >> 3] >> (cell & 7)) & 1;
+        int o = (o_plane[cell >> 3] >> (cell & 7)) & 1;
+        out[cell] = static_cast<int8_t>(x - o);
+    }
+}
+
+void unpack_float32(const uint8_t *x_plane, const uint8_t *o_plane, int cells, float *out) {
+    int8_t values[MAX_BOARD_CELLS];
+    unpack_int8(x_plane, o_plane, cells, values);
+    for (int cell = active_kernels().widen_float32(values, cells, out); cell < cells; ++cell) {
+        out[cell] = values[cell];
+    }
+}
+
+}  // namespace
+
+struct hex_reader {
+    hex_reader_options options;
+    int board_dim = 0;
+    uint32_t plane_bytes = 0;
+    uint32_t record_size = 0;
+    const uint8_t *records = nullptr;  // record_count packed records of record_size bytes
+    uint64_t record_count = 0;
+    MappedFile mapping;                // Backs records for .hxb input
+    std::vector<uint8_t> parsed;       // Backs records for CSV input
+
+    // Reading position: chunk_order[chunk_position], record_in_chunk records into it
+    std::vector<uint64_t> chunk_order;
+    uint64_t chunk_position = 0;
+    uint64_t record_in_chunk = 0;
+
+    // Prefetchers page in chunk_order[next_prefetch] while it is at most prefetch_chunks ahead
+    std::vector<std::thread> prefetchers;
+    std::mutex prefetch_mutex;
+    std::condition_variable prefetch_wake;
+    uint64_t next_prefetch = 0;
+    bool stopping = false;
+
+    ~hex_reader() {
+        {
+            std::lock_guard<std::mutex> lock(prefetch_mutex);
+            stopping = true;
+        }
+        prefetch_wake.notify_all();
+        for (auto& prefetcher : prefetchers) {
+            prefetcher.join();
+        }
+    }
+
+    uint64_t chunk_count() const {
+        return (record_count + options.chunk_records - 1) / options.chunk_records;
+    }
+
+    void prefetch_loop() {
+        size_t chunk_bytes = static_cast<size_t>(options.chunk_records) * record_size;
+        size_t records_offset = records - mapping.data;
+        while (true) {
+            uint64_t chunk;
+            {
+                std::unique_lock<std::mutex> lock(prefetch_mutex);
+                prefetch_wake.wait(lock, [this] {
+                    return stopping || (next_prefetch < chunk_order.size() &&
+                                        next_prefetch <= chunk_position + options.prefetch_chunks);
+                });
+                if (stopping) {
+                    return;
+                }
+                next_prefetch = std::max(next_prefetch, chunk_position + 1);  // Skip chunks already read
+                if (next_prefetch >= chunk_order.size()) {
+                    continue;
+                }
+                chunk = chunk_order[next_prefetch++];
+            }
+            mapping.prefetch(records_offset + chunk * chunk_bytes, chunk_bytes);
+        }
+    }
+
+    void start_epoch(uint64_t epoch) {
+        std::lock_guard<std::mutex> lock(prefetch_mutex);
+        chunk_order.resize(chunk_count());
+        for (uint64_t c = 0; c < chunk_order.size(); ++c) {
+            chunk_order[c] = c;
+        }
+        if (options.shuffle) {
+            std::mt19937_64 rng(options.seed ^ (0x9E3779B97F4A7C15ULL * (epoch + 1)));
+            std::shuffle(chunk_order.begin(), chunk_order.end(), rng);
+        }
+        chunk_position = 0;
+        record_in_chunk = 0;
+        next_prefetch = 0;
+        prefetch_wake.notify_all();
+    }
+
+    void decode(uint64_t first, uint64_t count, hex_batch *batch, uint64_t offset) {
+        int cells = board_dim * board_dim;
+        size_t board_bytes = hex_reader_board_bytes(this);
+        uint8_t *boards = static_cast<uint8_t*>(batch->boards) + offset * board_bytes;
+        for (uint64_t r = 0; r < count; ++r) {
+            const uint8_t *record = records + (first + r) * record_size;
+            const uint8_t *o_plane = record + plane_bytes;
+            if (options.layout == HEX_LAYOUT_INT8) {
+                unpack_int8(record, o_plane, cells, reinterpret_cast<int8_t*>(boards + r * board_bytes));
+            } else if (options.layout == HEX_LAYOUT_FLOAT32) {
+                unpack_float32(record, o_plane, cells, reinterpret_cast<float*>(boards + r * board_bytes));
+            } else {
+                std::memcpy(boards + r * board_bytes, record, board_bytes);
+            }
+            if (batch->starting_player != nullptr) {
+                batch->starting_player[offset + r] = static_cast<int8_t>(record[2 * plane_bytes]);
+            }
+            if (batch->winner != nullptr) {
+                batch->winner[offset + r] = static_cast<int8_t>(record[2 * plane_bytes + 1]);
+            }
+        }
+    }
+
+    // Parse a CSV or each CSV listed in a chunk manifest into parsed
+    bool load_csv(const std::string &path) {
+        MappedFile file;
+        if (!file.map(path)) {
+            last_error = "cannot open " + path;
+            return false;
+        }
+        std::string first_line(reinterpret_cast<const char*>(file.data),
+                               std::min<size_t>(file.size, 16));
+        if (first_line.rfind("chunk,filename,", 0) == 0) {
+            std::ifstream manifest(path);
+            std::string line;
+            std::getline(manifest, line);
+            std::string directory = path.substr(0, path.find_last_of("\\/") + 1);
+            while (std::getline(manifest, line)) {
+                size_t name_start = line.find(',') + 1;
+                if (name_start == 0) {
+                    continue;
+                }
+                std::string chunk = line.substr(name_start, line.find(',', name_start) - name_start);
+                if (!load_csv(directory + chunk)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        int threads = options.parse_threads != 0 ? options.parse_threads : std::max(1u, std::thread::hardware_concurrency());
+        if (!parse_csv(file, threads, board_dim, parsed)) {
+            last_error = path + ": " + last_error;
+            return false;
+        }
+        return true;
+    }
+
+    bool open(const std::string &path) {
+        if (!mapping.map(path)) {
+            last_error = "cannot open " + path;
+            return false;
+        }
+        if (mapping.size >= sizeof(BinaryDatasetHeader) &&
+            std::memcmp(mapping.data, BINARY_DATASET_MAGIC, sizeof(BINARY_DATASET_MAGIC)) == 0) {
+            BinaryDatasetHeader header;
+            std::memcpy(&header, mapping.data, sizeof(header));
+            if (header.board_dim == 0 || header.board_dim * header.board_dim > MAX_BOARD_CELLS ||
+                header.record_size < 2 * plane_bytes_for(header.board_dim) + 2 ||
+                header.header_size + header.record_count * header.record_size > mapping.size) {
+                last_error = "corrupt or truncated .hxb file " + path;
+                return false;
+            }
+            board_dim = header.board_dim;
+            record_size = header.record_size;
+            records = mapping.data + header.header_size;
+            record_count = header.record_count;
+        } else {
+            if (!load_csv(path)) {
+                return false;
+            }
+            record_size = record_size_for(board_dim);
+            records = parsed.data();
+            record_count = parsed.size() / record_size;
+        }
+        plane_bytes = plane_bytes_for(board_dim);
+        start_epoch(0);
+
+        // Parsed CSVs are already in memory, only mapped files benefit from prefetching
+        if (parsed.empty()) {
+            for (uint32_t t = 0; t < options.prefetch_threads; ++t) {
+                prefetchers.emplace_back(&hex_reader::prefetch_loop, this);
+            }
+        }
+        return true;
+    }
+};
+
+extern "C" {
+
+void hex_reader_default_options(hex_reader_options *options) {
+    options->batch_size = 1024;
+    options->layout = HEX_LAYOUT_INT8;
+    options->shuffle = 0;
+    options->chunk_records = 4096;
+    options->seed = 0;
+    options->prefetch_threads = 1;
+    options->prefetch_chunks = 4;
+    options->parse_threads = 0;
+}
+
+hex_reader *hex_reader_open(const char *path, const hex_reader_options *options) {
+    std::unique_ptr<hex_reader> reader(new hex_reader());
+    if (options != nullptr) {
+        reader->options = *options;
+    } else {
+        hex_reader_default_options(&reader->options);
+    }
+    if (reader->options.batch_size == 0 || reader->options.layout > HEX_LAYOUT_BITPACKED) {
+        last_error = "invalid options";
+        return nullptr;
+    }
+    reader->options.chunk_records = std::max(1u, reader->options.chunk_records);
+    if (!reader->open(path)) {
+        return nullptr;
+    }
+    return reader.release();
+}
+
+void hex_reader_close(hex_reader *reader) {
+    delete reader;
+}
+
+const char *hex_reader_last_error(void) {
+    return last_error.c_str();
+}
+
+const char *hex_reader_isa(void) {
+    return active_kernels().name;
+}
+
+int hex_reader_select_isa(const char *isa) {
+    std::string name = isa != nullptr ? isa : "auto";
+    const KernelSet *kernels = name == "auto" ? best_kernels() : find_kernels(name);
+    if (kernels == nullptr) {
+        last_error = "kernel set " + name + " is unknown or not supported by this CPU";
+        return 0;
+    }
+    selected_kernels.store(kernels, std::memory_order_release);
+    return 1;
+}
+
+int hex_reader_board_dim(const hex_reader *reader) {
+    return reader->board_dim;
+}
+
+uint64_t hex_reader_record_count(const hex_reader *reader) {
+    return reader->record_count;
+}
+
+size_t hex_reader_board_bytes(const hex_reader *reader) {
+    size_t cells = reader->board_dim * reader->board_dim;
+    if (reader->options.layout == HEX_LAYOUT_FLOAT32) {
+        return cells * sizeof(float);
+    }
+    if (reader->options.layout == HEX_LAYOUT_BITPACKED) {
+        return 2 * reader->plane_bytes;
+    }
+    return cells;
+}
+
+int64_t hex_reader_next_batch(hex_reader *reader, hex_batch *batch) {
+    uint64_t filled = 0;
+    uint64_t chunk_records = reader->options.chunk_records;
+    while (filled < reader->options.batch_size && reader->chunk_position < reader->chunk_order.size()) {
+        uint64_t first = reader->chunk_order[reader->chunk_position] * chunk_records;
+        uint64_t end = std::min(first + chunk_records, reader->record_count);
+        uint64_t start = first + reader->record_in_chunk;
+        uint64_t take = std::min<uint64_t>(reader->options.batch_size - filled, end - start);
+        reader->decode(start, take, batch, filled);
+        filled += take;
+        reader->record_in_chunk += take;
+        if (start + take == end) {
+            {
+                std::lock_guard<std::mutex> lock(reader->prefetch_mutex);
+                reader->chunk_position++;
+                reader->record_in_chunk = 0;
+            }
+            reader->prefetch_wake.notify_all();
+        }
+    }
+    return static_cast<int64_t>(filled);
+}
+
+void hex_reader_start_epoch(hex_reader *reader, uint64_t epoch) {
+    reader->start_epoch(epoch);
+}
+
+}  // extern "C"
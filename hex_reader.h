@@ -0,0 +1,86 @@
+// Dataset reader library for hex_gen_data output.
+//
+// Opens .hxb binary datasets, coord and string CSVs (including old string files) and chunk
+// manifests, and decodes them in batches into caller-provided arrays. Binary files are memory-mapped
+// and decoded straight from the mapping; CSVs are parsed once on open, in parallel, into the same
+// packed records. The interface is plain C so it can be loaded from Python with ctypes.
+
+#ifndef HEX_READER_H
+#define HEX_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(HEX_READER_BUILD)
+#define HEX_READER_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define HEX_READER_API __declspec(dllimport)
+#else
+#define HEX_READER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Board encodings for hex_batch.boards, cells in row-major order (cell = row * dim + col)
+enum hex_layout {
+    HEX_LAYOUT_INT8 = 0,       // int8 per cell: 1 for X, -1 for O, 0 for empty, as in coord CSVs
+    HEX_LAYOUT_FLOAT32 = 1,    // The same values as float
+    HEX_LAYOUT_BITPACKED = 2   // X plane then O plane of (dim * dim + 7) / 8 bytes each, as in .hxb files
+};
+
+typedef struct hex_reader_options {
+    uint32_t batch_size;        // Records per batch
+    uint32_t layout;            // hex_layout of the decoded boards
+    uint32_t shuffle;           // Visit chunks in a new random order every epoch
+    uint32_t chunk_records;     // Records per shuffle chunk
+    uint64_t seed;              // Shuffle seed, combined with the epoch number
+    uint32_t prefetch_threads;  // Threads paging in upcoming chunks of mapped files, 0 for none
+    uint32_t prefetch_chunks;   // How many chunks they stay ahead of the reader
+    uint32_t parse_threads;     // Threads parsing CSV input on open, 0 for one per core
+} hex_reader_options;
+
+// Caller-owned output arrays for one batch, each with room for batch_size records
+typedef struct hex_batch {
+    void *boards;               // batch_size * hex_reader_board_bytes() bytes
+    int8_t *starting_player;    // Or NULL
+    int8_t *winner;             // Or NULL
+} hex_batch;
+
+typedef struct hex_reader hex_reader;
+
+HEX_READER_API void hex_reader_default_options(hex_reader_options *options);
+
+// NULL on failure, see hex_reader_last_error. options may be NULL for the defaults.
+HEX_READER_API hex_reader *hex_reader_open(const char *path, const hex_reader_options *options);
+HEX_READER_API void hex_reader_close(hex_reader *reader);
+
+// Message of the last failure on the calling thread
+HEX_READER_API const char *hex_reader_last_error(void);
+
+// Vectorized kernels used for parsing and decoding: "avx512", "avx2" or "scalar". The widest set
+// the CPU supports is picked on first use unless the HEX_READER_ISA environment variable names
+// another. hex_reader_select_isa switches sets, or back to the automatic choice with "auto" or NULL;
+// it returns 0 if the set is unknown or unsupported here.
+HEX_READER_API const char *hex_reader_isa(void);
+HEX_READER_API int hex_reader_select_isa(const char *isa);
+
+HEX_READER_API int hex_reader_board_dim(const hex_reader *reader);
+HEX_READER_API uint64_t hex_reader_record_count(const hex_reader *reader);
+
+// Bytes of one decoded board in the configured layout
+HEX_READER_API size_t hex_reader_board_bytes(const hex_reader *reader);
+
+// Decode the next batch; returns the number of records written, 0 at the end of the epoch.
+// The last batch of an epoch may be short.
+HEX_READER_API int64_t hex_reader_next_batch(hex_reader *reader, hex_batch *batch);
+
+// Rewind to the start of the given epoch; with shuffling the chunk order depends on (seed, epoch)
+HEX_READER_API void hex_reader_start_epoch(hex_reader *reader, uint64_t epoch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
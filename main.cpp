@@ -32,16 +32,188 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <cstdio>
+#include <map>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
+#include <cmath>
 #include <sstream>
 #include <iomanip>
 #include <unordered_set>    // For unique game detection
+#include <unordered_map>
+#include <limits>
 #include <string>
 #include <sys/stat.h>       // For directory creation
 #include <filesystem>       // Required for checking if file exists (C++17 and later)
+#include "hex_reader.h"     // CSV parsing for dataset-convert
+#ifdef _MSC_VER
+#include <intrin.h>         // _BitScanForward64, __popcnt64
+#endif
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>          // open, fallocate, O_DIRECT for the Linux writer backends
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <linux/perf_event.h> // Hardware counters for the optional stage instrumentation
+#include <sys/ioctl.h>
+#endif
+#if defined(__APPLE__)
+#include <malloc/malloc.h>  // malloc_size for the allocation accounting
+#else
+#include <malloc.h>         // malloc_usable_size or _msize for the allocation accounting, malloc_trim
+#endif
+#include <new>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>        // GetProcessTimes, K32GetProcessMemoryInfo for the run manifest
+#include <psapi.h>
+#else
+#include <sys/resource.h>   // getrusage for the run manifest
+#include <unistd.h>
+#endif
 
 
+// Boards up to 16x16 fit in four 64-bit words per player
+const int MAX_PACKED_DIM = 16;
+
+// Bit-packed board, bit (i*dim + j) of x/o is set when cell (i, j) holds an X/O stone
+struct PackedBoard {
+    uint64_t x[4];
+    uint64_t o[4];
+
+    bool operator==(const PackedBoard &other) const {
+        return std::memcmp(this, &other, sizeof(PackedBoard)) == 0;
+    }
+
+    bool operator<(const PackedBoard &other) const {
+        return std::memcmp(this, &other, sizeof(PackedBoard)) < 0;
+    }
+
+    bool is_x(int cell) const { return (x[cell >> 6] >> (cell & 63)) & 1; }
+    bool is_o(int cell) const { return (o[cell >> 6] >> (cell & 63)) & 1; }
+
+    // Raw bytes, used as the duplicate-detection key
+    std::string key() const {
+        return std::string(reinterpret_cast<const char*>(this), sizeof(PackedBoard));
+    }
+
+    // 64-bit hash of the board, stable across runs and platforms
+    uint64_t hash() const {
+        uint64_t h = 0x9E3779B97F4A7C15ULL;
+        for (int w = 0; w < 4; ++w) {
+            h = mix64(h ^ x[w]);
+            h = mix64(h ^ o[w]);
+        }
+        return h;
+    }
+
+    // SplitMix64 finalizer
+    static uint64_t mix64(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
+
+inline int count_trailing_zeros(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+inline int count_set_bits(uint64_t value) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(value));
+#else
+    return __builtin_popcountll(value);
+#endif
+}
+
+// Counter-based random numbers (Philox4x32-10, Salmon et al., SC'11). Each game draws from its own
+// stream keyed by the config seed and indexed by the game number, so any game can be regenerated
+// from (config seed, game index) alone, in any order and on any thread.
+class PhiloxRng {
+public:
+    PhiloxRng(uint64_t seed, uint64_t stream) {
+        key[0] = static_cast<uint32_t>(seed);
+        key[1] = static_cast<uint32_t>(seed >> 32);
+        counter[0] = static_cast<uint32_t>(stream);
+        counter[1] = static_cast<uint32_t>(stream >> 32);
+        counter[2] = 0;
+        counter[3] = 0;
+    }
+
+    uint32_t next() {
+        if (index == 4) {
+            generate_block(counter, key, block);
+            if (++counter[2] == 0) {
+                ++counter[3];
+            }
+            index = 0;
+        }
+        return block[index++];
+    }
+
+    // Uniform value in [0, n) by multiply-shift
+    int next_below(int n) {
+        return static_cast<int>((static_cast<uint64_t>(next()) * static_cast<uint32_t>(n)) >> 32);
+    }
+
+    static void generate_block(const uint32_t in[4], const uint32_t in_key[2], uint32_t out[4]) {
+        uint32_t c[4] = {in[0], in[1], in[2], in[3]};
+        uint32_t k[2] = {in_key[0], in_key[1]};
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c[0];
+            uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c[2];
+            uint32_t next_c[4] = {
+                static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k[0],
+                static_cast<uint32_t>(p1),
+                static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+                static_cast<uint32_t>(p0)
+            };
+            std::memcpy(c, next_c, sizeof(c));
+            k[0] += 0x9E3779B9u;
+            k[1] += 0xBB67AE85u;
+        }
+        std::memcpy(out, c, sizeof(c));
+    }
+
+private:
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t block[4];
+    int index = 4;
+};
+
+// Derive the seed of one sweep configuration from the run seed and its parameters
+uint64_t config_seed(uint64_t seed, int board_dim, int total_games, int open_percent, int moves_before_end) {
+    uint64_t h = PackedBoard::mix64(seed ^ 0x9E3779B97F4A7C15ULL);
+    h = PackedBoard::mix64(h ^ static_cast<uint64_t>(board_dim));
+    h = PackedBoard::mix64(h ^ static_cast<uint64_t>(total_games));
+    h = PackedBoard::mix64(h ^ static_cast<uint64_t>(open_percent));
+    h = PackedBoard::mix64(h ^ static_cast<uint64_t>(moves_before_end));
+    return h;
+}
+
 class HexGame {
 public:
     int BOARD_DIM;
@@ -122,8 +294,15 @@ public:
     }
 
     int place_piece_randomly(int player) {
-        int random_empty_position_index = rand() % number_of_open_positions;
+        return place_piece(player, rand() % number_of_open_positions);
+    }
 
+    int place_piece_randomly(int player, PhiloxRng &rng) {
+        return place_piece(player, rng.next_below(number_of_open_positions));
+    }
+
+    // Place a stone on the open position at `random_empty_position_index` of open_positions
+    int place_piece(int player, int random_empty_position_index) {
         int empty_position = open_positions[random_empty_position_index];
 
         board[empty_position * 2 + player] = 1;
@@ -196,24 +375,101 @@ public:
         return coord_values;
     }
 
+    // Function to load a packed board, e.g. to export a board produced on another thread
+    void unpack_board(const PackedBoard &packed) {
+        for (int i = 0; i < BOARD_DIM; ++i) {
+            for (int j = 0; j < BOARD_DIM; ++j) {
+                int cell = i*BOARD_DIM + j;
+                int position = (i+1)*(BOARD_DIM+2) + j + 1;
+                board[position*2] = packed.is_x(cell);
+                board[position*2 + 1] = packed.is_o(cell);
+            }
+        }
+    }
+
+    // Function to pack the board into bitmasks, one bit per logical cell
+    PackedBoard pack_board() {
+        PackedBoard packed = {};
+        for (int i = 0; i < BOARD_DIM; ++i) {
+            for (int j = 0; j < BOARD_DIM; ++j) {
+                int cell = i*BOARD_DIM + j;
+                int position = (i+1)*(BOARD_DIM+2) + j + 1;
+                packed.x[cell >> 6] |= static_cast<uint64_t>(board[position*2] != 0) << (cell & 63);
+                packed.o[cell >> 6] |= static_cast<uint64_t>(board[position*2 + 1] != 0) << (cell & 63);
+            }
+        }
+        return packed;
+    }
+
+    // Label connected groups of same-coloured stones (1..k in row-major discovery order, 0 for empty cells)
+    std::vector<int> stone_groups() {
+        std::vector<int> groups(BOARD_DIM*BOARD_DIM, 0);
+        std::vector<int> stack;
+        int next_group = 0;
+        for (int i = 0; i < BOARD_DIM; ++i) {
+            for (int j = 0; j < BOARD_DIM; ++j) {
+                int start = (i+1)*(BOARD_DIM+2) + j + 1;
+                int player = board[start*2] ? 0 : (board[start*2 + 1] ? 1 : -1);
+                if (player < 0 || groups[i*BOARD_DIM + j] != 0) {
+                    continue;
+                }
+
+                next_group++;
+                groups[i*BOARD_DIM + j] = next_group;
+                stack.push_back(start);
+                while (!stack.empty()) {
+                    int position = stack.back();
+                    stack.pop_back();
+                    for (int k = 0; k < 6; ++k) {
+                        int neighbor = position + neighbors[k];
+                        // Padding cells never hold stones, so the walk stays on the board
+                        if (!board[neighbor*2 + player]) {
+                            continue;
+                        }
+                        int logical = (neighbor / (BOARD_DIM + 2) - 1) * BOARD_DIM + neighbor % (BOARD_DIM + 2) - 1;
+                        if (groups[logical] == 0) {
+                            groups[logical] = next_group;
+                            stack.push_back(neighbor);
+                        }
+                    }
+                }
+            }
+        }
+        return groups;
+    }
+
     // Function to write a game to CSV in either "coord" or regular format
-    void write_game_to_csv(std::ofstream &outfile, const std::string &format, const std::pair<std::string, int>& result) {
+    void write_game_to_csv(std::ostream &outfile, const std::string &format, const std::string &board_string,
+                           int starting_player, int winner, int symmetry = -1, long long game_index = -1) {
         if (format == "coord") {
             // This should not be called for coord format
             return;
         }
         // Write the board string
-        outfile << result.first << "," << result.second << "\n";
-
-
+        outfile << board_string << "," << starting_player << "," << winner;
+        if (symmetry >= 0) {
+            outfile << "," << symmetry;
+        }
+        if (game_index >= 0) {
+            outfile << "," << game_index;
+        }
+        outfile << "\n";
     }
 
-    void write_coord_game_to_csv(std::ofstream &outfile, const std::vector<int>& board_values, int starting_player, int winner) {
+    void write_coord_game_to_csv(std::ostream &outfile, const std::vector<int>& board_values, int starting_player,
+                                 int winner, int symmetry = -1, long long game_index = -1) {
         for (int value : board_values) {
             outfile << value << ",";
         }
         // Write the winner at the end
-        outfile << starting_player << "," << winner << "\n";
+        outfile << starting_player << "," << winner;
+        if (symmetry >= 0) {
+            outfile << "," << symmetry;
+        }
+        if (game_index >= 0) {
+            outfile << "," << game_index;
+        }
+        outfile << "\n";
     }
 
     void print() {
@@ -236,361 +492,6753 @@ public:
     }
 };
 
-// Function to generate a unique timestamp for the filename
-std::string generate_timestamp(bool detailed = false) {
-    // Get current time
-    std::time_t t = std::time(nullptr);
-    std::tm* time_ptr = std::localtime(&t);
+// Hardware performance counters per generation stage. With instrumentation enabled every thread
+// opens one perf_event group (Linux only) on first use and PerfRegion scopes attribute the counts
+// read at their boundaries to a stage. Counts are exclusive: a nested region pauses its parent, so
+// win checks are not also counted as playout. When the counters cannot be opened (other platforms,
+// perf_event_paranoid, no PMU in a VM) the regions do nothing and the run continues without them.
+enum PerfStage {
+    PERF_STAGE_PLAYOUT,
+    PERF_STAGE_WIN_CHECK,
+    PERF_STAGE_DEDUP,
+    PERF_STAGE_ENCODE,
+    PERF_STAGE_WRITE,
+    PERF_STAGE_COUNT
+};
+const char *PERF_STAGE_NAMES[PERF_STAGE_COUNT] = {"playout", "win_check", "dedup", "encode", "write"};
 
-    std::ostringstream oss;
+const int PERF_EVENT_CYCLES = 0;
+const int PERF_EVENT_INSTRUCTIONS = 1;
+const int PERF_EVENT_BRANCHES = 2;
+const int PERF_EVENT_BRANCH_MISSES = 3;
+const int PERF_EVENT_CACHE_MISSES = 4;
+const int PERF_EVENT_COUNT = 5;
+const char *PERF_EVENT_NAMES[PERF_EVENT_COUNT] = {"cycles", "instructions", "branches", "branch_misses", "cache_misses"};
 
-    if (detailed) {
-        // If detailed timestamp is requested: include year, month, day, hour, minute, second
-        oss << std::put_time(time_ptr, "%Y%m%d:%H%M%S");
+std::atomic<bool> perf_counters_enabled(false);  // Set before any generation thread starts
 
-        // Add milliseconds for more precision
-        auto now = std::chrono::system_clock::now();
-        auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-        oss << "." << std::setw(3) << std::setfill('0') << milliseconds.count();
-    } else {
-        // Simpler timestamp with hour, minute, second
-        oss << std::put_time(time_ptr, "%H%M%S");  // Hour, minute, second
+struct PerfTotals {
+    uint64_t counts[PERF_STAGE_COUNT][PERF_EVENT_COUNT] = {};
+    uint32_t available = 0;  // Bit e is set once any thread could open event e
+
+    void add(const PerfTotals &other) {
+        for (int s = 0; s < PERF_STAGE_COUNT; ++s) {
+            for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+                counts[s][e] += other.counts[s][e];
+            }
+        }
+        available |= other.available;
     }
+};
 
-    return oss.str();
-}
+class PerfCounters {
+public:
+    // The calling thread's counters, opened on first use
+    static PerfCounters &local() {
+        thread_local PerfCounters counters;
+        return counters;
+    }
 
-// Function to analyze the dataset and return metadata for documentation
-std::tuple<int, int, int, int> analyze_game_file(const std::string &filename, const std::string &format) {
-    std::ifstream infile(filename);
-    if (!infile.is_open()) {
-        std::cerr << "Failed to open the file: " << filename << std::endl;
-        return {0, 0, 0, 0};
+    // Totals of all threads since the last call. Threads that exited have already handed theirs
+    // over; the calling thread's are added here.
+    static PerfTotals collect() {
+        local().flush();
+        std::lock_guard<std::mutex> lock(global_mutex);
+        PerfTotals totals = global;
+        global = PerfTotals();
+        return totals;
     }
 
-    std::string line;
-    int wins_player_X = 0;
-    int wins_player_O = 0;
-    int total_games = 0;
+    // Start counting for `stage`; returns the stage to resume on leave
+    int enter(int stage) {
+        int previous = current;
+        credit();
+        current = stage;
+        return previous;
+    }
 
-    // Use an unordered_set to track unique games
-    std::unordered_set<std::string> unique_games;
+    void leave(int previous) {
+        credit();
+        current = previous;
+    }
 
-    // Read and process the file
-    bool first_line = true;  // Skip the first line (header)
-    while (std::getline(infile, line)) {
-        if (first_line) {
-            first_line = false;
-            continue;
+    ~PerfCounters() {
+        flush();
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
         }
+#endif
+    }
 
-        std::string board_state;
-        std::string winner_str;
-        if (format == "coord") {
-            // Extract the board state and winner
-            std::stringstream ss(line);
-            std::string cell;
-            board_state.clear();
+private:
+    int leader = -1;
+    int fds[PERF_EVENT_COUNT];
+    int slots[PERF_EVENT_COUNT];   // Position of each event in a group read, -1 if not opened
+    int opened = 0;
+    int current = -1;
+    uint64_t last[PERF_EVENT_COUNT] = {};
+    PerfTotals totals;
 
-            // Concatenate all cell values for uniqueness
-            while (std::getline(ss, cell, ',')) {
-                board_state += cell;
-            }
-            winner_str = board_state.back();  // Last value is the winner
-            board_state.pop_back();  // Remove the winner from the state
+    static inline std::mutex global_mutex;
+    static inline PerfTotals global;
+    static inline std::once_flag unavailable_notice;
 
+    PerfCounters() {
+        std::fill(std::begin(fds), std::end(fds), -1);
+        std::fill(std::begin(slots), std::end(slots), -1);
+#ifdef __linux__
+        const uint64_t configs[PERF_EVENT_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                    PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+                                                    PERF_COUNT_HW_CACHE_MISSES};
+        int error = 0;
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[e];
+            attr.disabled = leader < 0;   // The group starts with its leader
+            attr.exclude_kernel = 1;      // Allowed at perf_event_paranoid 2, and keeps the reads themselves out
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            fds[e] = syscall(__NR_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC);
+            if (fds[e] < 0) {
+                error = errno;
+                continue;
+            }
+            if (leader < 0) {
+                leader = fds[e];
+            }
+            slots[e] = opened++;
+            totals.available |= 1u << e;
+        }
+        if (leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            read_counts(last);
         } else {
-            // Non-coord format: extract board state and winner
-            std::stringstream ss(line);
-            std::getline(ss, board_state, ',');
-            std::getline(ss, winner_str, ',');
+            std::call_once(unavailable_notice, [error] {
+                std::cerr << "Performance counters unavailable (" << std::strerror(error) << "), continuing without them" << std::endl;
+            });
         }
+#else
+        std::call_once(unavailable_notice, [] {
+            std::cerr << "Performance counters need Linux perf events, continuing without them" << std::endl;
+        });
+#endif
+    }
 
-        // Add the board state to the set of unique games
-        unique_games.insert(board_state);
-
-        // Increment the winner count
-        int winner = std::stoi(winner_str);
-        if (winner == 0) {
-            wins_player_X++;
-        } else if (winner == 1) {
-            wins_player_O++;
+    bool read_counts(uint64_t *values) {
+#ifdef __linux__
+        uint64_t buffer[1 + PERF_EVENT_COUNT];  // Number of events, then their values in opening order
+        if (leader < 0 || ::read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>((1 + opened) * sizeof(uint64_t))) {
+            return false;
         }
-
-        total_games++;
+        for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+            values[e] = slots[e] >= 0 ? buffer[1 + slots[e]] : 0;
+        }
+        return true;
+#else
+        (void)values;
+        return false;
+#endif
     }
 
-    infile.close();
+    // Attribute the counts since the last read to the current stage
+    void credit() {
+        uint64_t now[PERF_EVENT_COUNT];
+        if (!read_counts(now)) {
+            return;
+        }
+        if (current >= 0) {
+            for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+                totals.counts[current][e] += now[e] - last[e];
+            }
+        }
+        std::copy(now, now + PERF_EVENT_COUNT, last);
+    }
 
-    int unique_games_count = unique_games.size();
+    void flush() {
+        credit();
+        std::lock_guard<std::mutex> lock(global_mutex);
+        global.add(totals);
+        uint32_t available = totals.available;
+        totals = PerfTotals();
+        totals.available = available;
+    }
+};
 
-    // Return total games, unique games, wins for player X and O
-    return {total_games, unique_games_count, wins_player_X, wins_player_O};
-}
+// Counts everything executed on this thread in its scope towards `stage`; a single branch when
+// instrumentation is off
+class PerfRegion {
+public:
+    explicit PerfRegion(PerfStage stage)
+        : counters(perf_counters_enabled.load(std::memory_order_relaxed) ? &PerfCounters::local() : nullptr) {
+        if (counters != nullptr) {
+            previous = counters->enter(stage);
+        }
+    }
 
-// Function to save metadata including removed moves to a separate CSV file
-void save_metadata_with_removed_moves(const std::string &metadata_filename, const std::string &dataset_filename,
-                                      int board_dim, int total_games, int unique_games, int wins_player_X,
-                                      int wins_player_O, const std::string &format,
-                                      const std::vector<std::vector<int>>& removed_moves_per_game, int moves_before_end) {
-    std::ofstream outfile(metadata_filename);
-    if (!outfile.is_open()) {
-        std::cerr << "Failed to open metadata file: " << metadata_filename << std::endl;
-        return;
+    ~PerfRegion() {
+        if (counters != nullptr) {
+            counters->leave(previous);
+        }
     }
 
-    // Write metadata header
-    outfile << "Filename,Board Dimension,Total Games,Unique Games,Player X Wins,Player O Wins,Format,Timestamp,Moves Before End,Removed Moves\n";
+    PerfRegion(const PerfRegion&) = delete;
+    PerfRegion &operator=(const PerfRegion&) = delete;
 
-    // Write metadata content
-    outfile << dataset_filename << ","
-            << board_dim << "x" << board_dim << ","
-            << total_games << ","
-            << unique_games << ","
-            << wins_player_X << ","
-            << wins_player_O << ","
-            << format << ","
-            << moves_before_end << ",";
+private:
+    PerfCounters *counters;
+    int previous = -1;
+};
 
-    // Write removed moves for each game
-    outfile << "{";
-    for (const auto& removed_moves : removed_moves_per_game) {
-        outfile << "{";
-        for (size_t i = 0; i < removed_moves.size(); ++i) {
-            outfile << removed_moves[i];  // Already in correct logical index form
-            if (i != removed_moves.size() - 1) {
-                outfile << ",";
-            }
+// Print IPC, misses per game and branch-miss rate per stage
+void report_perf_counters(const PerfTotals &totals, uint64_t games) {
+    if (totals.available == 0) {
+        return;
+    }
+    auto has = [&totals](int e) { return (totals.available >> e) & 1; };
+    std::cout << " - Performance counters (user mode):" << std::setfill(' ') << std::endl;
+    for (int s = 0; s < PERF_STAGE_COUNT; ++s) {
+        const uint64_t *counts = totals.counts[s];
+        if (counts[PERF_EVENT_CYCLES] == 0 && counts[PERF_EVENT_INSTRUCTIONS] == 0) {
+            continue;
         }
-        outfile << "}";
-        if (&removed_moves != &removed_moves_per_game.back()) {
-            outfile << ",";
+        std::cout << "   " << std::left << std::setw(10) << PERF_STAGE_NAMES[s] << std::right << std::fixed << std::setprecision(2);
+        if (has(PERF_EVENT_CYCLES)) {
+            std::cout << std::setw(12) << counts[PERF_EVENT_CYCLES] / 1e6 << " Mcycles";
         }
+        if (has(PERF_EVENT_CYCLES) && has(PERF_EVENT_INSTRUCTIONS)) {
+            std::cout << "  IPC " << counts[PERF_EVENT_INSTRUCTIONS] / std::max(1.0, static_cast<double>(counts[PERF_EVENT_CYCLES]));
+        }
+        if (has(PERF_EVENT_CACHE_MISSES)) {
+            std::cout << "  cache misses/game " << counts[PERF_EVENT_CACHE_MISSES] / std::max(1.0, static_cast<double>(games));
+        }
+        if (has(PERF_EVENT_BRANCHES) && has(PERF_EVENT_BRANCH_MISSES)) {
+            std::cout << "  branch misses " << 100.0 * counts[PERF_EVENT_BRANCH_MISSES] / std::max(1.0, static_cast<double>(counts[PERF_EVENT_BRANCHES])) << "%";
+        }
+        std::cout << std::defaultfloat << std::setprecision(6) << std::endl;
     }
-    outfile << "}\n";
-
-    outfile.close();
 }
 
-// Helper function to create a directory if it doesn't exist
-bool ensure_directory_exists(const std::string &directory) {
-    struct stat info;
-    if (stat(directory.c_str(), &info) != 0) {
-        // Directory does not exist, so create it
-        std::cout << "Creating directory: " << directory << std::endl;
-        #ifdef _WIN32
-            mkdir(directory.c_str());
-        #else
-            mkdir(directory.c_str(), 0777);  // UNIX-style
-        #endif
-        return true;
+// Play one random game from its counter-based stream; returns the winner (-1 if none). Game is
+// HexGame or a candidate engine with the same interface, see engine-diff
+template <typename Game>
+int play_random_game(Game &hg, uint64_t seed, uint64_t game_index, int &starting_player) {
+    PhiloxRng rng(seed, game_index);
+    hg.init();
+    starting_player = rng.next_below(2);  // 0 for Player X, 1 for Player O
+    int player = starting_player;
+
+    while (!hg.full_board()) {
+        int position = hg.place_piece_randomly(player, rng);
+
+        PerfRegion region(PERF_STAGE_WIN_CHECK);
+        if (hg.winner(player, position)) {
+            return player;
+        }
+        player = 1 - player;
     }
-    return false;
+    return -1;
 }
 
-int main() {
-    setvbuf(stdout, NULL, _IONBF, 0);  // Disable output buffering
-    srand(time(nullptr));
+// Candidate engine: HexGame's playout interface on logical cells, with win detection by union-find
+// over the stones plus four virtual edge nodes instead of a flood fill from the starting edge.
+// It draws open positions exactly as HexGame does, so it must match it game for game (engine-diff).
+class UnionFindHexGame {
+public:
+    int BOARD_DIM;
+    std::vector<int8_t> cells;  // 0 for X, 1 for O, -1 for empty
+    std::vector<int> open_positions;
+    int number_of_open_positions;
+    std::vector<int> moves;
 
-    // Ensure 'data' and 'metadata' directories exist
-    ensure_directory_exists("F:\\TsetlinModels\\data");
-    ensure_directory_exists("F:\\TsetlinModels\\metadata");
+    UnionFindHexGame(int dim) : BOARD_DIM(dim), cells(dim * dim), open_positions(dim * dim), parent(dim * dim + 4) {
+        moves.reserve(dim * dim);
+        init();
+    }
 
-    std::string format = "coord";
+    void init() {
+        int cell_count = BOARD_DIM * BOARD_DIM;
+        std::fill(cells.begin(), cells.end(), -1);
+        for (int c = 0; c < cell_count; ++c) {
+            open_positions[c] = c;
+        }
+        for (int n = 0; n < cell_count + 4; ++n) {
+            parent[n] = n;
+        }
+        number_of_open_positions = cell_count;
+        moves.clear();
+    }
 
+    int place_piece_randomly(int player, PhiloxRng &rng) {
+        return place_piece(player, rng.next_below(number_of_open_positions));
+    }
 
-    int total_games_list[] = {2000, 20000, 200000}; //,
-    int min_board_dim = 4;
-    int max_board_dim = 15;
-    float open_pos_list[] = {0.1,0.2,0.3,0.4}; // 0.00,0.05,0.1,0.15,0.2,0.25,0.3,0.35,0.4,0.45,,0.5
-    int mbf_list[] = {0}; //,2,5
+    // Place a stone on open position random_empty_position_index and merge it with its groups; returns the cell
+    int place_piece(int player, int random_empty_position_index) {
+        int cell = open_positions[random_empty_position_index];
+        open_positions[random_empty_position_index] = open_positions[number_of_open_positions - 1];
+        number_of_open_positions--;
+        cells[cell] = player;
+        moves.push_back(cell);
 
+        int row = cell / BOARD_DIM;
+        int col = cell % BOARD_DIM;
+        static const int row_offsets[6] = {-1, -1, 0, 0, 1, 1};
+        static const int col_offsets[6] = {1, 0, -1, 1, 0, -1};
+        for (int i = 0; i < 6; ++i) {
+            int r = row + row_offsets[i];
+            int c = col + col_offsets[i];
+            if (r >= 0 && r < BOARD_DIM && c >= 0 && c < BOARD_DIM && cells[r * BOARD_DIM + c] == player) {
+                unite(cell, r * BOARD_DIM + c);
+            }
+        }
+        int edge = edge_node(player, 0);
+        if ((player == 0 ? row : col) == 0) {
+            unite(cell, edge);
+        }
+        if ((player == 0 ? row : col) == BOARD_DIM - 1) {
+            unite(cell, edge + 1);
+        }
+        return cell;
+    }
 
-    for (int total_games_index = 0; total_games_index < 3; ++total_games_index) {
-        int total_games = total_games_list[total_games_index];
+    // 1 if the stone just placed at position joined player's two edges
+    int winner(int player, int) {
+        return find(edge_node(player, 0)) == find(edge_node(player, 1));
+    }
 
-        for (int board_dim = min_board_dim; board_dim <= max_board_dim; ++board_dim) {
+    bool full_board() {
+        return number_of_open_positions == 0;
+    }
 
-            for (int open_pos_index = 0; open_pos_index < 4; open_pos_index++) {
-                float n_open_pos = open_pos_list[open_pos_index];
+    // Take back the last n moves and return them; the groups are not split again, so a truncated
+    // game can be packed but not continued
+    std::vector<int> remove_last_n_moves(int n) {
+        std::vector<int> removed_moves;
+        for (int i = 0; i < n; ++i) {
+            removed_moves.push_back(moves.back());
+            cells[moves.back()] = -1;
+            moves.pop_back();
+        }
+        return removed_moves;
+    }
 
-                for (int mbf_index = 0; mbf_index < 1; mbf_index++) {
-                    int moves_before_end = mbf_list[mbf_index];
+    PackedBoard pack_board() {
+        PackedBoard packed = {};
+        for (int cell = 0; cell < BOARD_DIM * BOARD_DIM; ++cell) {
+            packed.x[cell >> 6] |= static_cast<uint64_t>(cells[cell] == 0) << (cell & 63);
+            packed.o[cell >> 6] |= static_cast<uint64_t>(cells[cell] == 1) << (cell & 63);
+        }
+        return packed;
+    }
 
-                    HexGame hg(board_dim);
-                    int open_pos = board_dim * board_dim * n_open_pos;
+private:
+    std::vector<int> parent;  // Cells, then the top, bottom, left and right edges
 
-                    // Measure time before saving the file
-                    auto start = std::chrono::high_resolution_clock::now();
+    int edge_node(int player, int side) {
+        return BOARD_DIM * BOARD_DIM + player * 2 + side;
+    }
 
-                    bool file_created = false;
-                    std::string filename;
+    int find(int node) {
+        while (parent[node] != node) {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+        return node;
+    }
 
-                    // Create the filename ONCE per combination of board_dim, total_games, n_open_pos, etc.
-                    filename = "F:\\TsetlinModels\\data\\";
-                    filename += std::to_string(board_dim);
-                    filename += "x" + std::to_string(board_dim);
-                    filename += "_" + std::to_string(total_games);
-                    filename += "_" + std::to_string(static_cast<int>(n_open_pos * 100));
-                    filename += "_" + std::to_string(moves_before_end);
-                    filename += ".csv";
-                    std::cout << "Constructed filename: " << filename;
+    void unite(int a, int b) {
+        parent[find(a)] = find(b);
+    }
+};
 
-                    if (std::filesystem::exists(filename)) {
-                        std::cout << " - File exists, skipping..." << std::endl;
-                        continue;  // Skip to the next iteration if file exists
-                    }
+// Board symmetries of hex. Rotating the board by 180 degrees keeps both players' goals, while
+// transposing it swaps them, so transposed variants also swap stone colours, starting player and winner.
+const int SYMMETRY_IDENTITY = 0;
+const int SYMMETRY_ROTATE_180 = 1;
+const int SYMMETRY_TRANSPOSE_SWAP = 2;
+const int SYMMETRY_ANTI_TRANSPOSE_SWAP = 3;  // Rotation followed by transpose
+const int SYMMETRY_COUNT = 4;
 
-                    // Create and open the file once for writing header
-                    std::ofstream outfile(filename);
-                    if (outfile.is_open()) {
-                        if (format == "coord") {
-                            for (int i = 0; i < board_dim; ++i) {
-                                for (int j = 0; j < board_dim; ++j) {
-                                    outfile << "cell" << i << "_" << j << ",";
-                                }
-                            }
-                            outfile << "starting_player,winner" << std::endl;
-                        } else {
-                            outfile << "board,starting_player,winner\n";
-                        }
-                        outfile.close();
-                        file_created = true;
-                    } else {
-                        std::cerr << "Error opening file: " << filename << std::endl;
-                        continue;  // Skip this combination if the file could not be created
-                    }
+class BoardSymmetry {
+public:
+    int board_dim;
+    std::vector<uint8_t> permutation[SYMMETRY_COUNT];  // Destination cell for every source cell
 
-                    std::unordered_set<std::string> unique_games; // Set to track unique games
-                    int valid_games = 0;
-                    int batch_size = total_games / 1;
-                    int empty_runs = 0;
-                    std::vector<std::pair<std::string, std::pair<int, int>>> game_results_string;
-                    std::vector<std::pair<std::vector<int>, std::pair<int, int>>> game_results_coord;
-                    std::vector<std::vector<int>> removed_moves_per_game;
-
-                    // Process the games
-                    while (valid_games < total_games) {
-                        //std::cout << "Valid games: " << valid_games << " | Empty runs: " << empty_runs << std::endl;
-                        hg.init();
-                        int starting_player = rand() % 2;  // 0 for Player X, 1 for Player O
-                        int player = starting_player;
-                        int winner = -1;
-
-                        // Simulate the game
-                        while (!hg.full_board()) {
-                            int position = hg.place_piece_randomly(player);
-
-                            if (hg.winner(player, position)) {
-                                winner = player;
-                                break;
-                            }
-                            player = 1 - player;
+    BoardSymmetry(int dim) : board_dim(dim) {
+        for (int s = 0; s < SYMMETRY_COUNT; ++s) {
+            permutation[s].resize(dim * dim);
+        }
+        for (int i = 0; i < dim; ++i) {
+            for (int j = 0; j < dim; ++j) {
+                int cell = i*dim + j;
+                permutation[SYMMETRY_IDENTITY][cell] = cell;
+                permutation[SYMMETRY_ROTATE_180][cell] = (dim-1-i)*dim + (dim-1-j);
+                permutation[SYMMETRY_TRANSPOSE_SWAP][cell] = j*dim + i;
+                permutation[SYMMETRY_ANTI_TRANSPOSE_SWAP][cell] = (dim-1-j)*dim + (dim-1-i);
+            }
+        }
+    }
+
+    static bool swaps_colours(int symmetry) {
+        return symmetry == SYMMETRY_TRANSPOSE_SWAP || symmetry == SYMMETRY_ANTI_TRANSPOSE_SWAP;
+    }
+
+    // Player labels (starting player, winner) follow the colour swap; -1 stays -1
+    static int map_player(int symmetry, int player) {
+        return (swaps_colours(symmetry) && player >= 0) ? 1 - player : player;
+    }
+
+    PackedBoard apply(const PackedBoard &board, int symmetry) const {
+        if (symmetry == SYMMETRY_IDENTITY) {
+            return board;
+        }
+        const uint8_t *table = permutation[symmetry].data();
+        bool swap = swaps_colours(symmetry);
+        PackedBoard result = {};
+        uint64_t *to_x = swap ? result.o : result.x;
+        uint64_t *to_o = swap ? result.x : result.o;
+        // Only occupied cells are visited, so sparse boards are cheap
+        for (int w = 0; w < 4; ++w) {
+            for (uint64_t bits = board.x[w]; bits; bits &= bits - 1) {
+                int to = table[w*64 + count_trailing_zeros(bits)];
+                to_x[to >> 6] |= 1ULL << (to & 63);
+            }
+            for (uint64_t bits = board.o[w]; bits; bits &= bits - 1) {
+                int to = table[w*64 + count_trailing_zeros(bits)];
+                to_o[to >> 6] |= 1ULL << (to & 63);
+            }
+        }
+        return result;
+    }
+
+    // Smallest board in the symmetry orbit; identical for every variant of the same game
+    PackedBoard canonical(const PackedBoard &board) const {
+        PackedBoard best = board;
+        for (int s = 1; s < SYMMETRY_COUNT; ++s) {
+            PackedBoard variant = apply(board, s);
+            if (variant < best) {
+                best = variant;
+            }
+        }
+        return best;
+    }
+};
+
+// A board waiting to be written, with its outcome, which symmetry produced it and its output split
+struct GameRecord {
+    PackedBoard board;
+    int starting_player;
+    int winner;
+    int symmetry;
+    int split;
+    uint64_t game_index;  // Position of the game in its config's counter-based random stream
+};
+
+// Pick a split from a game's hash so the assignment only depends on the game itself
+int assign_split(uint64_t hash, const std::vector<double> &fractions) {
+    double u = (hash >> 11) * (1.0 / 9007199254740992.0);  // Top 53 bits as a uniform value in [0, 1)
+    double cumulative = 0.0;
+    for (size_t i = 0; i + 1 < fractions.size(); ++i) {
+        cumulative += fractions[i];
+        if (u < cumulative) {
+            return i;
+        }
+    }
+    return fractions.size() - 1;
+}
+
+std::vector<int> packed_to_coord(const PackedBoard &board, int dim) {
+    std::vector<int> coord_values(dim * dim);
+    for (int cell = 0; cell < dim * dim; ++cell) {
+        coord_values[cell] = board.is_x(cell) ? 1 : (board.is_o(cell) ? -1 : 0);
+    }
+    return coord_values;
+}
+
+std::string packed_to_string(const PackedBoard &board, int dim) {
+    std::string board_string(dim * dim, ' ');
+    for (int cell = 0; cell < dim * dim; ++cell) {
+        if (board.is_x(cell)) {
+            board_string[cell] = 'X';
+        } else if (board.is_o(cell)) {
+            board_string[cell] = 'O';
+        }
+    }
+    return board_string;
+}
+
+// Target quotas per stratum (winner x starting player x game-length bucket) for balanced datasets.
+// Game length is the number of moves played before truncation. Buckets split the feasible range
+// [2*dim - 1, dim*dim - open_pos] into equal widths (a win needs at least dim stones of the winner).
+// Fill counters are atomics reserved with a CAS loop, so any number of workers can share one instance.
+class StratumQuotas {
+public:
+    int length_buckets;
+    int min_length;
+    int max_length;
+    std::vector<int> quota;
+    std::unique_ptr<std::atomic<int>[]> filled;
+
+    // User weights need one non-negative entry per stratum and a positive sum
+    static bool valid_weights(const std::vector<int> &weights, int buckets) {
+        if (weights.empty()) {
+            return true;
+        }
+        long long sum = 0;
+        bool negative = false;
+        for (int w : weights) {
+            sum += w;
+            negative = negative || w < 0;
+        }
+        return static_cast<int>(weights.size()) == 4 * buckets && !negative && sum > 0;
+    }
+
+    // Weights are scaled to total_games by largest remainder, so the quotas always sum to it and one
+    // list serves every game count of the sweep. No weights split total_games evenly; the sweep refuses
+    // invalid ones up front, so they only reach here when stratified sampling is off and are ignored.
+    StratumQuotas(int board_dim, int open_pos, int total_games, int buckets, const std::vector<int> &weights)
+        : length_buckets(buckets), min_length(2*board_dim - 1), max_length(board_dim*board_dim - open_pos) {
+        int strata = 4 * length_buckets;
+        std::vector<long long> scaled(strata, 1);
+        if (!weights.empty() && valid_weights(weights, buckets)) {
+            scaled.assign(weights.begin(), weights.end());
+        }
+        long long weight_sum = 0;
+        for (long long w : scaled) {
+            weight_sum += w;
+        }
+        quota.assign(strata, 0);
+        std::vector<std::pair<long long, int>> remainders;  // (remainder, stratum)
+        int assigned = 0;
+        for (int s = 0; s < strata; ++s) {
+            quota[s] = total_games * scaled[s] / weight_sum;
+            assigned += quota[s];
+            remainders.push_back({total_games * scaled[s] % weight_sum, s});
+        }
+        std::stable_sort(remainders.begin(), remainders.end(),
+                         [](const std::pair<long long, int> &a, const std::pair<long long, int> &b) { return a.first > b.first; });
+        for (int r = 0; r < total_games - assigned; ++r) {
+            quota[remainders[r].second]++;
+        }
+        filled.reset(new std::atomic<int>[strata]);
+        for (int s = 0; s < strata; ++s) {
+            filled[s].store(0);
+        }
+    }
+
+    int stratum_count() const {
+        return quota.size();
+    }
+
+    // Stratum index (winner*2 + starting_player)*length_buckets + bucket, or -1 for a drawn game
+    int stratum(int winner, int starting_player, int game_length) const {
+        if (winner < 0) {
+            return -1;
+        }
+        int span = std::max(1, max_length - min_length + 1);
+        int bucket = (game_length - min_length) * length_buckets / span;
+        bucket = std::min(std::max(bucket, 0), length_buckets - 1);
+        return (winner*2 + starting_player)*length_buckets + bucket;
+    }
+
+    // Claim a slot in the stratum; false once it is full
+    bool try_reserve(int s) {
+        if (s < 0) {
+            return false;
+        }
+        int current = filled[s].load(std::memory_order_relaxed);
+        while (current < quota[s]) {
+            if (filled[s].compare_exchange_weak(current, current + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Give back a slot whose game was rejected later (e.g. as a duplicate)
+    void release(int s) {
+        filled[s].fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Print strata lagging well behind the overall fill rate
+    void report_slow_strata(long long playouts, bool all_unfilled = false) const {
+        long long total_filled = 0;
+        long long total_quota = 0;
+        for (int s = 0; s < stratum_count(); ++s) {
+            total_filled += filled[s].load(std::memory_order_relaxed);
+            total_quota += quota[s];
+        }
+        double overall = total_quota > 0 ? static_cast<double>(total_filled) / total_quota : 1.0;
+        for (int s = 0; s < stratum_count(); ++s) {
+            int count = filled[s].load(std::memory_order_relaxed);
+            if (count >= quota[s]) {
+                continue;
+            }
+            double fraction = static_cast<double>(count) / quota[s];
+            if (all_unfilled || fraction < 0.5 * overall) {
+                int bucket = s % length_buckets;
+                int span = std::max(1, max_length - min_length + 1);
+                std::cout << "   Slow stratum: winner " << (s / length_buckets) / 2
+                          << ", starting player " << (s / length_buckets) % 2
+                          << ", length " << min_length + bucket * span / length_buckets
+                          << "-" << min_length + (bucket + 1) * span / length_buckets - 1
+                          << " - " << count << "/" << quota[s]
+                          << " after " << playouts << " playouts" << std::endl;
+            }
+        }
+    }
+};
+
+// Parameters the playout workers need to filter, truncate and key a game on their own
+struct PlayoutSettings {
+    int board_dim;
+    uint64_t seed;
+    int open_pos;
+    int moves_before_end;
+    bool canonical_keys;  // Dedupe on the symmetry-canonical board
+    bool split_output;
+    std::vector<double> split_fractions;
+    bool record_moves;    // Keep the full move list of valid games
+    bool record_all_moves; // Also keep it for games failing the open-position threshold
+};
+
+// One simulated game as handed from the workers to the committing thread
+struct PlayoutResult {
+    uint64_t game_index;
+    bool valid;                      // Enough open positions left to be kept
+    int starting_player;
+    int winner;
+    int game_length;                 // Moves played before truncation
+    int split;
+    PackedBoard board;               // After removing the last moves
+    std::vector<int> removed_moves;
+    std::vector<int> moves;          // Full game in play order, only if record_moves
+    std::string board_key;           // Duplicate-detection key
+    uint64_t key_hash;               // PackedBoard::hash of the key board
+};
+
+uint64_t nanoseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Opt-in timeline of a sweep as Chrome trace-event JSON, viewable in chrome://tracing or
+// ui.perfetto.dev. Every thread records spans into its own buffer, so recording takes no locks;
+// a buffer keeps the newest TraceLog::capacity spans, overwriting the oldest. Buffers outlive their
+// threads and are written out after the generation threads have been joined. With tracing off a
+// span costs one predictable branch.
+std::atomic<bool> tracing_enabled(false);  // Set before any generation thread starts
+
+struct TraceEvent {
+    const char *name;       // Static strings only
+    const char *category;
+    uint64_t start_ns;      // Since TraceLog::epoch
+    uint64_t duration_ns;
+    uint64_t arg;
+    char label[32];         // Optional text such as the config name, truncated
+};
+
+struct TraceBuffer {
+    int tid;
+    std::string thread_name;
+    std::vector<TraceEvent> events;  // Ring of at most TraceLog::capacity spans once full
+    uint64_t recorded = 0;
+};
+
+class TraceLog {
+public:
+    static inline size_t capacity = 1 << 16;
+    static const uint64_t MIN_WAIT_NS = 10000;
+    static inline const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    static void name_thread(const char *name) {
+        if (tracing_enabled.load(std::memory_order_relaxed)) {
+            local().thread_name = name;
+        }
+    }
+
+    // Record a span from `start` until now
+    static void record(const char *name, const char *category, std::chrono::steady_clock::time_point start,
+                       uint64_t arg = 0, const char *label = nullptr) {
+        if (!tracing_enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        auto end = std::chrono::steady_clock::now();
+        TraceEvent event = {name, category, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count()),
+                            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()), arg, {}};
+        if (label != nullptr) {
+            std::strncpy(event.label, label, sizeof(event.label) - 1);
+        }
+        TraceBuffer &buffer = local();
+        if (buffer.events.size() < capacity) {
+            buffer.events.push_back(event);
+        } else {
+            buffer.events[buffer.recorded % capacity] = event;
+        }
+        buffer.recorded++;
+    }
+
+    // Record a wait from `start` until now, unless it was too short to matter
+    static void record_wait(const char *name, const char *category, std::chrono::steady_clock::time_point start,
+                            uint64_t waited_ns, uint64_t arg = 0) {
+        if (tracing_enabled.load(std::memory_order_relaxed) && waited_ns >= MIN_WAIT_NS) {
+            record(name, category, start, arg);
+        }
+    }
+
+    // Write every thread's spans; call only while no other thread is recording
+    static bool write(const std::string &filename, uint64_t seed) {
+        std::ofstream outfile(filename);
+        if (!outfile.is_open()) {
+            std::cerr << "Failed to open trace file: " << filename << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        uint64_t dropped = 0;
+        outfile << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (const auto& buffer : buffers) {
+            outfile << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                    << ",\"args\":{\"name\":\"" << buffer->thread_name << "\"}}";
+            first = false;
+            for (const TraceEvent &event : buffer->events) {
+                outfile << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                        << buffer->tid << ",\"ts\":" << event.start_ns / 1e3 << ",\"dur\":" << event.duration_ns / 1e3
+                        << ",\"args\":{\"arg\":" << event.arg;
+                if (event.label[0] != '\0') {
+                    outfile << ",\"label\":\"" << event.label << "\"";
+                }
+                outfile << "}}";
+            }
+            dropped += buffer->recorded - buffer->events.size();
+        }
+        outfile << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"seed\":" << seed << ",\"dropped_spans\":" << dropped << "}}\n";
+        return static_cast<bool>(outfile);
+    }
+
+private:
+    static inline std::mutex buffers_mutex;
+    static inline std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+    static TraceBuffer &local() {
+        thread_local TraceBuffer *buffer = nullptr;
+        if (buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+            buffers.emplace_back(new TraceBuffer());
+            buffer = buffers.back().get();
+            buffer->tid = buffers.size();
+            buffer->thread_name = "thread " + std::to_string(buffer->tid);
+        }
+        return *buffer;
+    }
+};
+
+// Records its scope as one span of the timeline
+class TraceSpan {
+public:
+    TraceSpan(const char *span_name, const char *span_category, uint64_t span_arg = 0, const char *span_label = nullptr)
+        : active(tracing_enabled.load(std::memory_order_relaxed)) {
+        if (active) {
+            name = span_name;
+            category = span_category;
+            arg = span_arg;
+            label = span_label;
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (active) {
+            TraceLog::record(name, category, start, arg, label);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan &operator=(const TraceSpan&) = delete;
+
+private:
+    bool active;
+    const char *name = nullptr;
+    const char *category = nullptr;
+    uint64_t arg = 0;
+    const char *label = nullptr;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Counters of one generation pipeline stage. Times are summed over the stage's threads: busy on the
+// stage's own work, starved waiting for input and blocked waiting for room downstream. The input
+// queue's occupancy is sampled on every push.
+struct StageMetrics {
+    std::string name;
+    int threads;
+    std::atomic<uint64_t> items{0};
+    std::atomic<uint64_t> busy_ns{0};
+    std::atomic<uint64_t> starved_ns{0};
+    std::atomic<uint64_t> blocked_ns{0};
+    std::atomic<uint64_t> queue_samples{0};
+    std::atomic<uint64_t> queue_occupancy{0};
+    uint64_t queue_capacity = 0;
+
+    StageMetrics(const std::string &stage_name, int stage_threads) : name(stage_name), threads(stage_threads) {}
+
+    void sample_queue(uint64_t occupancy) {
+        queue_samples.fetch_add(1, std::memory_order_relaxed);
+        queue_occupancy.fetch_add(occupancy, std::memory_order_relaxed);
+    }
+};
+
+// Print per-stage utilisation; the stage with the highest busy share is the bottleneck
+void report_stage_metrics(const std::vector<const StageMetrics*> &stages, double elapsed_seconds) {
+    const StageMetrics *bottleneck = nullptr;
+    double bottleneck_busy = -1.0;
+    for (const StageMetrics *stage : stages) {
+        double busy = stage->busy_ns / (1e9 * elapsed_seconds * stage->threads);
+        if (busy > bottleneck_busy) {
+            bottleneck = stage;
+            bottleneck_busy = busy;
+        }
+    }
+    std::cout << "   stage     threads        items   busy  starved  blocked  queue" << std::endl;
+    for (const StageMetrics *stage : stages) {
+        double scale = 100.0 / (1e9 * elapsed_seconds * stage->threads);
+        std::cout << "   " << std::left << std::setw(8) << std::setfill(' ') << stage->name << std::right
+                  << std::setw(8) << stage->threads << std::setw(13) << stage->items
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(6) << stage->busy_ns * scale << "%"
+                  << std::setw(8) << stage->starved_ns * scale << "%"
+                  << std::setw(8) << stage->blocked_ns * scale << "%";
+        if (stage->queue_capacity != 0 && stage->queue_samples != 0) {
+            std::cout << std::setw(6) << 100.0 * stage->queue_occupancy / stage->queue_samples / stage->queue_capacity << "%";
+        } else {
+            std::cout << "      -";
+        }
+        std::cout << std::defaultfloat << (stage == bottleneck ? "  <- bottleneck" : "") << std::endl;
+    }
+}
+
+// Bounded multi-producer multi-consumer ring buffer (Vyukov's sequence-numbered cells). push and pop
+// are lock-free; a full queue makes producers wait, which is the pipeline's backpressure.
+template <typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(size_t min_capacity, StageMetrics &consumer_metrics) : consumer(consumer_metrics) {
+        size_t capacity = 2;
+        while (capacity < min_capacity) {
+            capacity <<= 1;
+        }
+        cells.reset(new Cell[capacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mask = capacity - 1;
+        consumer.queue_capacity = capacity;
+    }
+
+    // Wait while the queue is full; returns the nanoseconds spent waiting
+    uint64_t push(T &&value) {
+        uint64_t waited = 0;
+        if (!try_push(value)) {
+            auto start = std::chrono::steady_clock::now();
+            for (int attempt = 0; !try_push(value); ++attempt) {
+                backoff(attempt);
+            }
+            waited = nanoseconds_since(start);
+            TraceLog::record_wait("queue full", "queue", start, waited);
+        }
+        consumer.sample_queue(enqueue_pos.load(std::memory_order_relaxed) - dequeue_pos.load(std::memory_order_relaxed));
+        return waited;
+    }
+
+    // Wait while the queue is empty; false once it is closed and drained
+    bool pop(T &value, uint64_t &waited) {
+        waited = 0;
+        if (try_pop(value)) {
+            return true;
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int attempt = 0;; ++attempt) {
+            bool was_closed = closed.load(std::memory_order_acquire);
+            if (try_pop(value)) {
+                waited = nanoseconds_since(start);
+                TraceLog::record_wait("queue empty", "queue", start, waited);
+                return true;
+            }
+            if (was_closed) {
+                waited = nanoseconds_since(start);
+                TraceLog::record_wait("queue empty", "queue", start, waited);
+                return false;
+            }
+            backoff(attempt);
+        }
+    }
+
+    // No more pushes will follow
+    void close() {
+        closed.store(true, std::memory_order_release);
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    StageMetrics &consumer;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+    std::atomic<bool> closed{false};
+
+    bool try_push(T &value) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Full
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T &value) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Empty
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Spin briefly, then yield, then sleep so idle stages do not burn a core
+    static void backoff(int attempt) {
+        if (attempt < 64) {
+            return;
+        }
+        if (attempt < 128) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+};
+
+// Runs playouts on worker threads and hands them back strictly in game-index order.
+//
+// Workers claim blocks of consecutive game indices and park finished blocks in a reorder buffer.
+// The committing thread takes blocks in order, so which games are accepted, which duplicate
+// survives and the row order are identical for any thread count. Workers may run at most
+// max_blocks_in_flight blocks ahead of the committer, which bounds the buffer's memory.
+class PlayoutGenerator {
+public:
+    StageMetrics metrics;
+
+    // The reorder buffer is the input queue of the committing stage, whose metrics sample it. Games are
+    // played from first_game_index on, so a resumed config picks up where its checkpoint left off.
+    PlayoutGenerator(const PlayoutSettings &playout_settings, int num_threads, StageMetrics &consumer_metrics,
+                     int games_per_block = 256, uint64_t first_game_index = 0)
+        : metrics("playout", std::max(1, num_threads)), settings(playout_settings), block_size(games_per_block),
+          first_game(first_game_index), consumer(consumer_metrics) {
+        num_threads = std::max(1, num_threads);
+        max_blocks_in_flight = 4 * num_threads;
+        consumer.queue_capacity = max_blocks_in_flight;
+        for (int t = 0; t < num_threads; ++t) {
+            workers.emplace_back(&PlayoutGenerator::worker_loop, this);
+        }
+    }
+
+    ~PlayoutGenerator() {
+        stop();
+    }
+
+    // Results of the next block of game indices, waiting for the workers if needed
+    std::vector<PlayoutResult> next_block() {
+        std::unique_lock<std::mutex> lock(mutex);
+        block_ready.wait(lock, [this] { return finished.count(next_commit) != 0; });
+        std::vector<PlayoutResult> results = std::move(finished[next_commit]);
+        finished.erase(next_commit);
+        next_commit++;
+        window_open.notify_all();
+        return results;
+    }
+
+    // Discard outstanding work and join the workers
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        window_open.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    }
+
+    // Play game game_index of the config and filter, truncate and key it
+    static void play(const PlayoutSettings &settings, HexGame &hg, const BoardSymmetry &symmetry, uint64_t game_index,
+                     PlayoutResult &result) {
+        result.game_index = game_index;
+        result.winner = play_random_game(hg, settings.seed, game_index, result.starting_player);
+        result.game_length = hg.moves.size();
+        result.valid = hg.number_of_open_positions >= settings.open_pos;
+        if (!result.valid) {
+            if (settings.record_all_moves) {
+                result.moves = hg.moves;
+            }
+            return;
+        }
+
+        // The split follows the canonical final board, so every truncation and
+        // symmetric variant of a game lands in the same split
+        result.split = 0;
+        if (settings.split_output) {
+            result.split = assign_split(symmetry.canonical(hg.pack_board()).hash(), settings.split_fractions);
+        }
+
+        if (settings.record_moves) {
+            result.moves = hg.moves;
+        }
+        result.removed_moves = hg.remove_last_n_moves(settings.moves_before_end);
+        result.board = hg.pack_board();
+
+        // With augmentation every variant of a game shares the canonical key,
+        // so symmetric copies are never counted as new games
+        PackedBoard key_board = settings.canonical_keys ? symmetry.canonical(result.board) : result.board;
+        result.board_key = key_board.key();
+        result.key_hash = key_board.hash();
+    }
+
+private:
+    PlayoutSettings settings;
+    int block_size;
+    uint64_t first_game;
+    StageMetrics &consumer;
+    uint64_t max_blocks_in_flight;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable block_ready;
+    std::condition_variable window_open;
+    std::map<uint64_t, std::vector<PlayoutResult>> finished;  // Reorder buffer, keyed by block
+    uint64_t next_claim = 0;
+    uint64_t next_commit = 0;
+    bool stopping = false;
+
+    void worker_loop() {
+        TraceLog::name_thread("playout");
+        HexGame hg(settings.board_dim);
+        BoardSymmetry symmetry(settings.board_dim);
+        while (true) {
+            uint64_t block;
+            auto wait_start = std::chrono::steady_clock::now();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                window_open.wait(lock, [this] { return stopping || next_claim < next_commit + max_blocks_in_flight; });
+                if (stopping) {
+                    return;
+                }
+                block = next_claim++;
+            }
+            uint64_t waited = nanoseconds_since(wait_start);
+            metrics.blocked_ns += waited;
+            TraceLog::record_wait("wait for commit window", "playout", wait_start, waited, block);
+
+            auto work_start = std::chrono::steady_clock::now();
+            std::vector<PlayoutResult> results(block_size);
+            {
+                TraceSpan span("playout block", "playout", block);
+                PerfRegion region(PERF_STAGE_PLAYOUT);
+                for (int g = 0; g < block_size; ++g) {
+                    play(settings, hg, symmetry, first_game + block * block_size + g, results[g]);
+                }
+            }
+            metrics.busy_ns += nanoseconds_since(work_start);
+            metrics.items += block_size;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished[block] = std::move(results);
+                consumer.sample_queue(finished.size());
+            }
+            block_ready.notify_one();
+        }
+    }
+
+};
+
+// Output backends for dataset files. "ofstream" works everywhere; on Linux "posix" writes large
+// buffers with write(2) and "uring" keeps several buffer writes in flight per file through io_uring
+// with registered, page-aligned buffers. Both Linux backends preallocate the expected file size
+// with fallocate and can bypass the page cache with O_DIRECT.
+class FileWriter {
+public:
+    virtual ~FileWriter() {}
+    // Create or truncate the file, reserving preallocate_bytes of disk space when supported
+    virtual bool open(const std::string &filename, uint64_t preallocate_bytes) = 0;
+    virtual bool write(const char *data, size_t size) = 0;
+    virtual bool close() = 0;
+
+    bool write(const std::string &data) {
+        return write(data.data(), data.size());
+    }
+
+    static std::unique_ptr<FileWriter> create(const std::string &backend, bool direct_io);
+};
+
+class StreamFileWriter : public FileWriter {
+public:
+    std::ofstream outfile;
+
+    bool open(const std::string &filename, uint64_t) override {
+        outfile.open(filename, std::ios::binary);
+        return outfile.is_open();
+    }
+
+    bool write(const char *data, size_t size) override {
+        outfile.write(data, size);
+        return static_cast<bool>(outfile);
+    }
+
+    bool close() override {
+        if (!outfile.is_open()) {
+            return true;
+        }
+        outfile.close();
+        return !outfile.fail();
+    }
+};
+
+#ifdef __linux__
+const size_t WRITER_BUFFER_SIZE = 1 << 20;  // Multiple of the O_DIRECT alignment
+const size_t WRITER_ALIGNMENT = 4096;
+
+// Shared file handling of the Linux backends: aligned staging buffers, preallocation, O_DIRECT
+// with a buffered tail write, and trimming the preallocation on close.
+class LinuxFileWriter : public FileWriter {
+public:
+    explicit LinuxFileWriter(bool direct) : direct_io(direct) {}
+
+    bool open(const std::string &filename, uint64_t preallocate_bytes) override {
+        path = filename;
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        fd = direct_io ? ::open(filename.c_str(), flags | O_DIRECT, 0644) : -1;
+        if (fd < 0) {
+            // Filesystems such as tmpfs reject O_DIRECT; fall back to buffered I/O
+            fd = ::open(filename.c_str(), flags, 0644);
+            direct_io = false;
+        }
+        if (fd < 0) {
+            std::cerr << "Failed to open " << filename << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (preallocate_bytes > 0) {
+            fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, preallocate_bytes);  // Best effort
+        }
+        file_offset = 0;
+        return true;
+    }
+
+protected:
+    bool direct_io;
+    std::string path;
+    int fd = -1;
+    uint64_t file_offset = 0;   // Bytes handed to the kernel so far
+
+    static char *allocate_buffer() {
+        void *buffer = nullptr;
+        if (posix_memalign(&buffer, WRITER_ALIGNMENT, WRITER_BUFFER_SIZE) != 0) {
+            return nullptr;
+        }
+        return static_cast<char*>(buffer);
+    }
+
+    bool write_fully(const char *data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            ssize_t written = pwrite(fd, data, size, offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "Write to " << path << " failed: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            data += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    // Write the final partial buffer without O_DIRECT, drop unused preallocation and close
+    bool finish(const char *tail, size_t tail_size) {
+        bool ok = true;
+        if (tail_size > 0) {
+            if (direct_io) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+            }
+            ok = write_fully(tail, tail_size, file_offset);
+            file_offset += tail_size;
+        }
+        ok = ftruncate(fd, file_offset) == 0 && ok;
+        ok = ::close(fd) == 0 && ok;
+        fd = -1;
+        return ok;
+    }
+};
+
+class PosixFileWriter : public LinuxFileWriter {
+public:
+    explicit PosixFileWriter(bool direct) : LinuxFileWriter(direct) {}
+
+    ~PosixFileWriter() override {
+        close();
+        free(buffer);
+    }
+
+    bool open(const std::string &filename, uint64_t preallocate_bytes) override {
+        if (!buffer && !(buffer = allocate_buffer())) {
+            return false;
+        }
+        used = 0;
+        return LinuxFileWriter::open(filename, preallocate_bytes);
+    }
+
+    bool write(const char *data, size_t size) override {
+        while (size > 0) {
+            size_t chunk = std::min(size, WRITER_BUFFER_SIZE - used);
+            std::memcpy(buffer + used, data, chunk);
+            used += chunk;
+            data += chunk;
+            size -= chunk;
+            if (used == WRITER_BUFFER_SIZE) {
+                if (!write_fully(buffer, used, file_offset)) {
+                    return false;
+                }
+                file_offset += used;
+                used = 0;
+            }
+        }
+        return true;
+    }
+
+    bool close() override {
+        if (fd < 0) {
+            return true;
+        }
+        bool ok = finish(buffer, used);
+        used = 0;
+        return ok;
+    }
+
+private:
+    char *buffer = nullptr;
+    size_t used = 0;
+};
+
+// Minimal io_uring driver over the raw syscalls, so no liburing dependency is needed
+class UringFileWriter : public LinuxFileWriter {
+public:
+    static const unsigned QUEUE_DEPTH = 8;  // Buffers, and so writes in flight, per file
+
+    explicit UringFileWriter(bool direct) : LinuxFileWriter(direct) {}
+
+    ~UringFileWriter() override {
+        close();
+        if (ring_fd >= 0) {
+            ::close(ring_fd);
+        }
+        if (sq_ring) munmap(sq_ring, sq_ring_size);
+        if (cq_ring) munmap(cq_ring, cq_ring_size);
+        if (sqes) munmap(sqes, sqes_size);
+        for (char *buffer : buffers) {
+            free(buffer);
+        }
+    }
+
+    // Set up the ring and buffers; false when io_uring is unavailable (old kernel, seccomp, ...)
+    bool init() {
+        io_uring_params params = {};
+        ring_fd = syscall(__NR_io_uring_setup, QUEUE_DEPTH, &params);
+        if (ring_fd < 0) {
+            return false;
+        }
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+        if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+            sq_ring = sq_ring == MAP_FAILED ? nullptr : sq_ring;
+            cq_ring = cq_ring == MAP_FAILED ? nullptr : cq_ring;
+            sqes = sqes == MAP_FAILED ? nullptr : sqes;
+            return false;
+        }
+        char *sq = static_cast<char*>(sq_ring);
+        char *cq = static_cast<char*>(cq_ring);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        std::vector<iovec> iovecs;
+        for (unsigned b = 0; b < QUEUE_DEPTH; ++b) {
+            char *buffer = allocate_buffer();
+            if (!buffer) {
+                return false;
+            }
+            buffers.push_back(buffer);
+            free_buffers.push_back(b);
+            iovecs.push_back({buffer, WRITER_BUFFER_SIZE});
+        }
+        pending_bytes.assign(QUEUE_DEPTH, 0);
+        pending_offset.assign(QUEUE_DEPTH, 0);
+        // Registered buffers skip the per-write page pinning; plain writes still work without them
+        registered = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), QUEUE_DEPTH) == 0;
+        return true;
+    }
+
+    bool open(const std::string &filename, uint64_t preallocate_bytes) override {
+        failed = false;
+        current = -1;
+        used = 0;
+        return LinuxFileWriter::open(filename, preallocate_bytes);
+    }
+
+    bool write(const char *data, size_t size) override {
+        while (size > 0 && !failed) {
+            if (current < 0) {
+                while (free_buffers.empty() && !failed) {
+                    reap(true);
+                }
+                if (failed) {
+                    break;
+                }
+                current = free_buffers.back();
+                free_buffers.pop_back();
+                used = 0;
+            }
+            size_t chunk = std::min(size, WRITER_BUFFER_SIZE - used);
+            std::memcpy(buffers[current] + used, data, chunk);
+            used += chunk;
+            data += chunk;
+            size -= chunk;
+            if (used == WRITER_BUFFER_SIZE) {
+                submit(current, used);
+                current = -1;
+                used = 0;
+            }
+        }
+        return !failed;
+    }
+
+    bool close() override {
+        if (fd < 0) {
+            return true;
+        }
+        // A ring that cannot be entered any more will never complete the remaining writes
+        while (in_flight > 0 && reap(true)) {
+        }
+        bool ok = finish(current >= 0 ? buffers[current] : nullptr, current >= 0 ? used : 0) && !failed;
+        if (current >= 0) {
+            free_buffers.push_back(current);
+            current = -1;
+        }
+        used = 0;
+        return ok;
+    }
+
+private:
+    int ring_fd = -1;
+    void *sq_ring = nullptr;
+    void *cq_ring = nullptr;
+    io_uring_sqe *sqes = nullptr;
+    size_t sq_ring_size = 0, cq_ring_size = 0, sqes_size = 0;
+    unsigned *sq_tail = nullptr, *sq_array = nullptr, *cq_head = nullptr, *cq_tail = nullptr;
+    unsigned sq_mask = 0, cq_mask = 0;
+    io_uring_cqe *cqes = nullptr;
+    bool registered = false;
+
+    std::vector<char*> buffers;
+    std::vector<unsigned> free_buffers;
+    std::vector<size_t> pending_bytes;
+    std::vector<uint64_t> pending_offset;
+    unsigned in_flight = 0;
+    int current = -1;
+    size_t used = 0;
+    bool failed = false;
+
+    void submit(unsigned buffer, size_t size) {
+        unsigned tail = *sq_tail;
+        unsigned slot = tail & sq_mask;
+        io_uring_sqe *sqe = &sqes[slot];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buffers[buffer]);
+        sqe->len = size;
+        sqe->off = file_offset;
+        sqe->buf_index = registered ? buffer : 0;
+        sqe->user_data = buffer;
+        sq_array[slot] = slot;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        long submitted;
+        while ((submitted = syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0)) < 0 && errno == EINTR) {
+        }
+        if (submitted != 1) {
+            // The kernel did not take the entry: withdraw it if it is still queued, no completion will come
+            if (submitted < 0) {
+                std::cerr << "io_uring submit for " << path << " failed: " << std::strerror(errno) << std::endl;
+                __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+            } else {
+                std::cerr << "io_uring dropped a write to " << path << std::endl;
+            }
+            free_buffers.push_back(buffer);
+            failed = true;
+            return;
+        }
+        pending_bytes[buffer] = size;
+        pending_offset[buffer] = file_offset;
+        file_offset += size;
+        in_flight++;
+    }
+
+    // Collect finished writes, first waiting for one if asked; false when the ring itself failed
+    bool reap(bool wait) {
+        if (wait) {
+            long result;
+            while ((result = syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0)) < 0 &&
+                   errno == EINTR) {
+            }
+            if (result < 0) {
+                std::cerr << "io_uring wait for " << path << " failed: " << std::strerror(errno) << std::endl;
+                failed = true;
+                return false;
+            }
+        }
+        unsigned head = *cq_head;
+        while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe &cqe = cqes[head & cq_mask];
+            unsigned buffer = cqe.user_data;
+            if (cqe.res < 0) {
+                std::cerr << "io_uring write to " << path << " failed: " << std::strerror(-cqe.res) << std::endl;
+                failed = true;
+            } else if (static_cast<size_t>(cqe.res) < pending_bytes[buffer]) {
+                // Short writes are rare for regular files; finish them synchronously
+                failed = !write_fully(buffers[buffer] + cqe.res, pending_bytes[buffer] - cqe.res,
+                                      pending_offset[buffer] + cqe.res) || failed;
+            }
+            free_buffers.push_back(buffer);
+            in_flight--;
+            head++;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+#endif
+
+std::unique_ptr<FileWriter> FileWriter::create(const std::string &backend, bool direct_io) {
+#ifdef __linux__
+    if (backend == "uring") {
+        std::unique_ptr<UringFileWriter> writer(new UringFileWriter(direct_io));
+        if (writer->init()) {
+            return std::unique_ptr<FileWriter>(writer.release());
+        }
+        static bool warned = false;
+        if (!warned) {
+            std::cerr << "io_uring is unavailable, falling back to write()" << std::endl;
+            warned = true;
+        }
+        return std::unique_ptr<FileWriter>(new PosixFileWriter(direct_io));
+    }
+    if (backend == "posix") {
+        return std::unique_ptr<FileWriter>(new PosixFileWriter(direct_io));
+    }
+#endif
+    return std::unique_ptr<FileWriter>(new StreamFileWriter());
+}
+
+// CRC-32 as used by zlib and gzip, so chunk checksums can be verified with zlib.crc32
+uint32_t crc32_update(uint32_t crc, const char *data, size_t size) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> entries(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+        return entries;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+std::string chunk_manifest_filename(const std::string &filename) {
+    return filename.substr(0, filename.size() - 4) + ".manifest.csv";
+}
+
+// Rolls a dataset CSV over into standalone chunk files {dataset}.part00000.csv, .part00001.csv, ...
+// of at most max_records rows or max_bytes bytes each (0 for no limit), cutting only at row ends.
+// Every chunk repeats the CSV header, so loaders can hand chunks to separate workers. close() writes
+// {dataset}.manifest.csv with each chunk's row range, the byte range of its rows and a CRC-32 of the
+// whole chunk file. resume() reopens an interrupted dataset after a given row, so a sweep only
+// regenerates what follows its last checkpoint (see ResumeJournal).
+class ChunkedFileWriter : public FileWriter {
+public:
+    std::atomic<uint64_t> durable_records{0};  // Rows in closed chunks, read by the committing thread
+    uint64_t resumed_records = 0;              // Rows kept by resume()
+
+    ChunkedFileWriter(const std::string &writer_backend, bool writer_direct_io, const std::string &csv_header,
+                      uint64_t chunk_records, uint64_t chunk_bytes, uint64_t chunk_preallocate_bytes)
+        : backend(writer_backend), direct_io(writer_direct_io), header(csv_header), max_records(chunk_records),
+          max_bytes(chunk_bytes), chunk_preallocate(chunk_preallocate_bytes) {}
+
+    bool open(const std::string &filename, uint64_t preallocate_bytes) override {
+        base = filename.substr(0, filename.size() - 4);
+        manifest_filename = chunk_manifest_filename(filename);
+        chunk_preallocate = std::min(chunk_preallocate, preallocate_bytes);
+        chunks.clear();
+        durable_records = 0;
+        partial_row = false;
+        return open_chunk();
+    }
+
+    // Keep the first kept_records rows of an interrupted dataset and continue after them: whole chunks
+    // are adopted as they are, the chunk holding the last kept row is rewritten up to it and later
+    // chunks are removed. False when the chunks hold fewer complete rows, found before anything changes.
+    bool resume(const std::string &filename, uint64_t preallocate_bytes, uint64_t kept_records) {
+        base = filename.substr(0, filename.size() - 4);
+        manifest_filename = chunk_manifest_filename(filename);
+        chunk_preallocate = std::min(chunk_preallocate, preallocate_bytes);
+        chunks.clear();
+        durable_records = 0;
+        partial_row = false;
+        uint64_t remaining = kept_records;
+        std::string kept_rows;  // Of the chunk that is cut
+        while (remaining > 0) {
+            Chunk chunk;
+            chunk.filename = part_filename(base, chunks.size());
+            std::ifstream infile(chunk.filename, std::ios::binary);
+            std::string text((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+            if (!infile.is_open() || text.compare(0, header.size(), header) != 0) {
+                return false;
+            }
+            size_t end = header.size();
+            while (remaining > 0) {
+                size_t newline = text.find('\n', end);
+                if (newline == std::string::npos) {
+                    break;
+                }
+                end = newline + 1;
+                chunk.records++;
+                remaining--;
+            }
+            if (end < text.size()) {
+                if (remaining > 0) {
+                    return false;  // Torn chunk
+                }
+                kept_rows = text.substr(header.size(), end - header.size());
+                break;
+            }
+            chunk.data_bytes = text.size() - header.size();
+            chunk.crc = crc32_update(0, text.data(), text.size());
+            durable_records += chunk.records;
+            chunks.push_back(chunk);
+        }
+        if (!open_chunk() || !write(kept_rows.data(), kept_rows.size())) {
+            return false;
+        }
+        for (size_t c = chunks.size(); ; ++c) {
+            std::error_code error;
+            if (!std::filesystem::remove(part_filename(base, c), error)) {
+                break;
+            }
+        }
+        resumed_records = kept_records;
+        return true;
+    }
+
+    bool write(const char *data, size_t size) override {
+        while (size > 0) {
+            // Take whole rows while the chunk has room; a chunk always gets at least one row
+            size_t span = 0;
+            while (span < size) {
+                const char *end = static_cast<const char*>(std::memchr(data + span, '\n', size - span));
+                size_t row = end != nullptr ? end - (data + span) + 1 : size - span;
+                Chunk &chunk = chunks.back();
+                bool has_rows = chunk.records > 0 || span > 0;
+                if (has_rows && !partial_row && ((max_records != 0 && chunk.records >= max_records) ||
+                                                 (max_bytes != 0 && chunk.data_bytes + span + row > max_bytes))) {
+                    break;
+                }
+                span += row;
+                partial_row = end == nullptr;
+                if (!partial_row) {
+                    chunk.records++;
+                }
+            }
+            if (span > 0) {
+                Chunk &chunk = chunks.back();
+                chunk.crc = crc32_update(chunk.crc, data, span);
+                chunk.data_bytes += span;
+                if (!writer->write(data, span)) {
+                    return false;
+                }
+                data += span;
+                size -= span;
+            }
+            if (size > 0 && !(close_chunk() && open_chunk())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool close() override {
+        if (!writer) {
+            return true;
+        }
+        bool ok = close_chunk();
+        writer.reset();
+        std::ofstream manifest(manifest_filename);
+        manifest << "chunk,filename,first_record,records,data_offset,data_bytes,crc32\n";
+        uint64_t first_record = 0;
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            const Chunk &chunk = chunks[c];
+            manifest << c << "," << chunk.filename.substr(chunk.filename.find_last_of("\\/") + 1) << ","
+                     << first_record << "," << chunk.records << "," << header.size() << "," << chunk.data_bytes << ","
+                     << std::hex << std::setw(8) << std::setfill('0') << chunk.crc << std::dec << std::setfill(' ') << "\n";
+            first_record += chunk.records;
+        }
+        manifest.close();
+        if (manifest.fail()) {
+            std::cerr << "Error writing file: " << manifest_filename << std::endl;
+            ok = false;
+        }
+        return ok;
+    }
+
+    std::vector<std::string> chunk_filenames() const {
+        std::vector<std::string> filenames;
+        for (const auto& chunk : chunks) {
+            filenames.push_back(chunk.filename);
+        }
+        return filenames;
+    }
+
+    static std::string part_filename(const std::string &base, size_t index) {
+        std::ostringstream name;
+        name << base << ".part" << std::setw(5) << std::setfill('0') << index << ".csv";
+        return name.str();
+    }
+
+private:
+    struct Chunk {
+        std::string filename;
+        uint64_t records = 0;
+        uint64_t data_bytes = 0;  // Row bytes after the header
+        uint32_t crc = 0;         // Of the whole file, header included
+    };
+
+    std::string backend;
+    bool direct_io;
+    std::string header;
+    uint64_t max_records;
+    uint64_t max_bytes;
+    uint64_t chunk_preallocate;
+    std::string base;
+    std::string manifest_filename;
+    std::unique_ptr<FileWriter> writer;
+    std::vector<Chunk> chunks;
+    bool partial_row = false;  // The last write ended mid-row, which must stay in this chunk
+
+    bool open_chunk() {
+        chunks.emplace_back();
+        chunks.back().filename = part_filename(base, chunks.size() - 1);
+        writer = FileWriter::create(backend, direct_io);
+        if (!writer->open(chunks.back().filename, chunk_preallocate)) {
+            std::cerr << "Error opening file: " << chunks.back().filename << std::endl;
+            writer.reset();
+            return false;
+        }
+        chunks.back().crc = crc32_update(0, header.data(), header.size());
+        return writer->write(header);
+    }
+
+    bool close_chunk() {
+        bool ok = writer->close();
+        if (!ok) {
+            std::cerr << "Error writing file: " << chunks.back().filename << std::endl;
+        } else {
+            durable_records += chunks.back().records;
+        }
+        return ok;
+    }
+};
+
+// Progress of a chunked dataset still being written, kept in {dataset}.resume beside its chunks so an
+// interrupted sweep continues after the last complete chunk instead of starting over. The journal logs
+// the removed moves of each game as it is committed and, whenever a chunk is closed, a checkpoint of
+// the committing stage at the last batch that chunk completes. Games are committed in game-index order
+// from the config's seed, so continuing from the checkpoint's game index with its counters and quota
+// fill, and the dedupe keys of the kept rows, writes the same rows an uninterrupted run would.
+class ResumeJournal {
+public:
+    struct Checkpoint {
+        uint64_t records = 0;        // All of them in closed chunks
+        uint64_t removed_moves = 0;  // Entries of the removed-moves log
+        long long valid_games = 0;
+        long long playouts = 0;      // Also the index of the next game to commit
+        long long playouts_since_accept = 0;
+        long long empty_runs = 0;
+        long long duplicates = 0;
+        long long quota_rejected = 0;
+        std::vector<int> quota_fill;  // Per stratum
+    };
+
+    static std::string filename_for(const std::string &dataset_filename) {
+        return dataset_filename.substr(0, dataset_filename.size() - 4) + ".resume";
+    }
+
+    // The last complete checkpoint of a journal written with the same settings, and the removed moves
+    // it covers; false when there is none
+    static bool load(const std::string &filename, const std::string &settings, uint64_t &seed,
+                     Checkpoint &checkpoint, std::vector<std::vector<int>> &removed_moves) {
+        std::ifstream infile(filename);
+        std::string line;
+        if (!std::getline(infile, line) || line != "settings " + settings || !std::getline(infile, line)) {
+            return false;
+        }
+        std::istringstream seed_line(line);
+        std::string key;
+        if (!(seed_line >> key >> seed) || key != "seed") {
+            return false;
+        }
+        bool found = false;
+        removed_moves.clear();
+        while (std::getline(infile, line)) {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            if (kind == "removed") {
+                std::vector<int> moves;
+                int move;
+                while (fields >> move) {
+                    moves.push_back(move);
+                }
+                removed_moves.push_back(std::move(moves));
+            } else if (kind == "checkpoint") {
+                // A line torn by the interruption lacks the closing "end"
+                Checkpoint entry;
+                size_t strata = 0;
+                fields >> entry.records >> entry.removed_moves >> entry.valid_games >> entry.playouts
+                       >> entry.playouts_since_accept >> entry.empty_runs >> entry.duplicates >> entry.quota_rejected >> strata;
+                entry.quota_fill.resize(fields ? strata : 0);
+                for (int &fill : entry.quota_fill) {
+                    fields >> fill;
+                }
+                std::string end;
+                if (fields >> end && end == "end" && entry.removed_moves <= removed_moves.size()) {
+                    checkpoint = entry;
+                    found = true;
+                }
+            }
+        }
+        if (found) {
+            removed_moves.resize(checkpoint.removed_moves);
+        }
+        return found && checkpoint.records > 0;
+    }
+
+    // Start the journal, carrying over a resumed checkpoint and the removed moves it covers. The new
+    // journal replaces the old one only once it is complete.
+    bool open(const std::string &journal_filename, const std::string &settings, uint64_t seed,
+              const Checkpoint *resumed = nullptr, const std::vector<std::vector<int>> &removed_moves = {}) {
+        filename = journal_filename;
+        std::string temp_filename = filename + ".tmp";
+        out.open(temp_filename, std::ios::trunc);
+        out << "settings " << settings << "\nseed " << seed << "\n";
+        for (const auto& moves : removed_moves) {
+            removed(moves);
+        }
+        if (resumed != nullptr) {
+            checkpoint(*resumed);
+        }
+        out.close();
+        std::error_code error;
+        if (out.fail() || (std::filesystem::rename(temp_filename, filename, error), error)) {
+            std::cerr << "Error writing file: " << filename << " - the config cannot be resumed" << std::endl;
+            std::filesystem::remove(temp_filename, error);
+            return false;
+        }
+        out.open(filename, std::ios::app);
+        return out.is_open();
+    }
+
+    bool is_open() const {
+        return out.is_open();
+    }
+
+    void removed(const std::vector<int> &moves) {
+        if (!out.is_open()) {
+            return;
+        }
+        out << "removed";
+        for (int move : moves) {
+            out << " " << move;
+        }
+        out << "\n";
+    }
+
+    // Flushed with the removed moves before it; a journal that cannot be written is given up
+    void checkpoint(const Checkpoint &entry) {
+        if (!out.is_open()) {
+            return;
+        }
+        out << "checkpoint " << entry.records << " " << entry.removed_moves << " " << entry.valid_games << " "
+            << entry.playouts << " " << entry.playouts_since_accept << " " << entry.empty_runs << " "
+            << entry.duplicates << " " << entry.quota_rejected << " " << entry.quota_fill.size();
+        for (int fill : entry.quota_fill) {
+            out << " " << fill;
+        }
+        out << " end\n";
+        out.flush();
+        if (!out) {
+            std::cerr << "Error writing file: " << filename << " - the config cannot be resumed" << std::endl;
+            out.close();
+        }
+    }
+
+    // The dataset is complete
+    void remove() {
+        out.close();
+        std::error_code error;
+        std::filesystem::remove(filename, error);
+    }
+
+private:
+    std::string filename;
+    std::ofstream out;
+};
+
+// Upper bound on the CSV size of `records` rows, used to preallocate output files
+uint64_t estimate_csv_bytes(const std::string &format, int board_dim, uint64_t records) {
+    uint64_t cells = board_dim * board_dim;
+    uint64_t row = (format == "coord" ? 3 * cells : cells + 1) + 32;  // "-1," per cell plus the label columns
+    return (row * records + 4095) & ~4095ULL;
+}
+
+// Write the dataset CSV header line
+void write_csv_header(std::ostream &outfile, const std::string &format, int board_dim, bool symmetry_column,
+                      bool game_index_column) {
+    if (format == "coord") {
+        for (int i = 0; i < board_dim; ++i) {
+            for (int j = 0; j < board_dim; ++j) {
+                outfile << "cell" << i << "_" << j << ",";
+            }
+        }
+        outfile << "starting_player,winner";
+    } else {
+        outfile << "board,starting_player,winner";
+    }
+    if (symmetry_column) {
+        outfile << ",symmetry";
+    }
+    if (game_index_column) {
+        outfile << ",game_index";
+    }
+    outfile << std::endl;
+}
+
+// Create a dataset CSV through the given writer backend and write its header. With a chunk_records
+// or chunk_bytes limit the dataset is written as chunk files plus a manifest instead, continuing after
+// the first resume_records rows of existing chunks when they are intact.
+std::unique_ptr<FileWriter> open_csv_writer(const std::string &filename, const std::string &backend, bool direct_io,
+                                            uint64_t preallocate_bytes, const std::string &format, int board_dim,
+                                            bool symmetry_column, bool game_index_column,
+                                            uint64_t chunk_records = 0, uint64_t chunk_bytes = 0,
+                                            uint64_t resume_records = 0) {
+    std::ostringstream header;
+    write_csv_header(header, format, board_dim, symmetry_column, game_index_column);
+    std::unique_ptr<FileWriter> writer;
+    if (chunk_records != 0 || chunk_bytes != 0) {
+        uint64_t chunk_preallocate = chunk_bytes != 0 ? chunk_bytes + 4096 : preallocate_bytes;
+        if (chunk_records != 0) {
+            chunk_preallocate = std::min(chunk_preallocate, estimate_csv_bytes(format, board_dim, chunk_records) + 4096);
+        }
+        ChunkedFileWriter *chunked = new ChunkedFileWriter(backend, direct_io, header.str(), chunk_records, chunk_bytes,
+                                                           chunk_preallocate);
+        writer.reset(chunked);
+        if (resume_records != 0) {
+            if (chunked->resume(filename, preallocate_bytes, resume_records)) {
+                return writer;
+            }
+            std::cerr << "Cannot resume the chunks of " << filename << ", regenerating them" << std::endl;
+        }
+        if (!writer->open(filename, preallocate_bytes)) {
+            return nullptr;
+        }
+        return writer;
+    }
+    writer = FileWriter::create(backend, direct_io);
+    if (!writer->open(filename, preallocate_bytes)) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return nullptr;
+    }
+    writer->write(header.str());
+    return writer;
+}
+
+// Format records as CSV rows, one string per split
+std::vector<std::string> encode_results_csv(size_t splits, const std::string &format, HexGame &hg,
+                                            const std::vector<GameRecord> &results, bool symmetry_column,
+                                            bool game_index_column) {
+    std::vector<std::ostringstream> chunks(splits);
+    for (const auto& result : results) {
+        std::ostringstream &outfile = chunks[result.split];
+        int symmetry = symmetry_column ? result.symmetry : -1;
+        long long game_index = game_index_column ? static_cast<long long>(result.game_index) : -1;
+        if (format == "coord") {
+            hg.write_coord_game_to_csv(outfile, packed_to_coord(result.board, hg.BOARD_DIM), result.starting_player, result.winner, symmetry, game_index);
+        } else {
+            hg.write_game_to_csv(outfile, format, packed_to_string(result.board, hg.BOARD_DIM), result.starting_player, result.winner, symmetry, game_index);
+        }
+    }
+    std::vector<std::string> text(splits);
+    for (size_t f = 0; f < splits; ++f) {
+        text[f] = chunks[f].str();
+    }
+    return text;
+}
+
+// Append buffered records to the dataset CSV of their split, on the calling thread
+void write_results_to_csv(std::vector<std::unique_ptr<FileWriter>> &writers, const std::string &format, HexGame &hg,
+                          const std::vector<GameRecord> &results, bool symmetry_column, bool game_index_column) {
+    std::vector<std::string> text = encode_results_csv(writers.size(), format, hg, results, symmetry_column, game_index_column);
+    for (size_t f = 0; f < writers.size(); ++f) {
+        writers[f]->write(text[f]);
+    }
+}
+
+// Encode and write stages of the dataset pipeline.
+//
+// The committing thread submits batches of accepted records. Encode threads format batches into CSV
+// text in parallel, and one write thread hands the text to the FileWriters in submission order, so
+// the files are byte-identical to writing inline. Both queues are bounded: a slow disk first
+// stalls the encoders and then the committer, instead of buffering without limit.
+class CsvOutputPipeline {
+public:
+    StageMetrics encode_metrics;
+    StageMetrics write_metrics;
+
+    CsvOutputPipeline(std::vector<std::unique_ptr<FileWriter>> &file_writers, const std::string &csv_format,
+                      int board_dim, bool symmetry_column, bool game_index_column, int encode_threads,
+                      size_t queue_batches)
+        : encode_metrics("encode", std::max(1, encode_threads)), write_metrics("write", 1),
+          writers(file_writers), format(csv_format), dim(board_dim), with_symmetry(symmetry_column),
+          with_game_index(game_index_column), encode_queue(queue_batches, encode_metrics),
+          write_queue(queue_batches, write_metrics) {
+        for (int t = 0; t < encode_metrics.threads; ++t) {
+            encoders.emplace_back(&CsvOutputPipeline::encode_loop, this);
+        }
+        writer_thread = std::thread(&CsvOutputPipeline::write_loop, this);
+    }
+
+    ~CsvOutputPipeline() {
+        finish();
+    }
+
+    // Queue a batch for output; returns the nanoseconds spent waiting for room
+    uint64_t submit(std::vector<GameRecord> &&records) {
+        return encode_queue.push({next_sequence++, std::move(records)});
+    }
+
+    // Drain both stages and join their threads; false if any write failed
+    bool finish() {
+        if (!writer_thread.joinable()) {
+            return write_ok;
+        }
+        encode_queue.close();
+        for (auto& encoder : encoders) {
+            encoder.join();
+        }
+        write_queue.close();
+        writer_thread.join();
+        return write_ok;
+    }
+
+private:
+    struct RecordBatch {
+        uint64_t sequence;
+        std::vector<GameRecord> records;
+    };
+
+    struct TextBatch {
+        uint64_t sequence;
+        size_t records;
+        std::vector<std::string> text;  // Per split
+    };
+
+    std::vector<std::unique_ptr<FileWriter>> &writers;
+    std::string format;
+    int dim;
+    bool with_symmetry;
+    bool with_game_index;
+    BoundedQueue<RecordBatch> encode_queue;
+    BoundedQueue<TextBatch> write_queue;
+    std::vector<std::thread> encoders;
+    std::thread writer_thread;
+    uint64_t next_sequence = 0;
+    bool write_ok = true;
+
+    void encode_loop() {
+        TraceLog::name_thread("encode");
+        HexGame hg(dim);
+        RecordBatch batch;
+        uint64_t waited;
+        while (encode_queue.pop(batch, waited)) {
+            encode_metrics.starved_ns += waited;
+            auto start = std::chrono::steady_clock::now();
+            TraceSpan span("encode batch", "output", batch.records.size());
+            PerfRegion region(PERF_STAGE_ENCODE);
+            TextBatch text = {batch.sequence, batch.records.size(),
+                              encode_results_csv(writers.size(), format, hg, batch.records, with_symmetry, with_game_index)};
+            encode_metrics.busy_ns += nanoseconds_since(start);
+            encode_metrics.items += batch.records.size();
+            encode_metrics.blocked_ns += write_queue.push(std::move(text));
+        }
+        encode_metrics.starved_ns += waited;
+    }
+
+    void write_loop() {
+        TraceLog::name_thread("write");
+        std::map<uint64_t, TextBatch> pending;  // Batches encoded ahead of the next one to write
+        uint64_t next_write = 0;
+        TextBatch batch;
+        uint64_t waited;
+        while (write_queue.pop(batch, waited)) {
+            write_metrics.starved_ns += waited;
+            uint64_t sequence = batch.sequence;
+            pending[sequence] = std::move(batch);
+            auto start = std::chrono::steady_clock::now();
+            TraceSpan span("write batches", "output", sequence);
+            PerfRegion region(PERF_STAGE_WRITE);
+            for (auto next = pending.find(next_write); next != pending.end(); next = pending.find(++next_write)) {
+                for (size_t f = 0; f < writers.size(); ++f) {
+                    if (!next->second.text[f].empty()) {
+                        write_ok = writers[f]->write(next->second.text[f]) && write_ok;
+                    }
+                }
+                write_metrics.items += next->second.records;
+                pending.erase(next);
+            }
+            write_metrics.busy_ns += nanoseconds_since(start);
+        }
+        write_metrics.starved_ns += waited;
+    }
+};
+
+// Compact fixed-stride binary dataset, {dataset}.hxb. Every record has the same size, so record i
+// sits at header_size + i * record_size: writers can fill slots in any order and readers can mmap
+// the file and index records directly. All integers are little-endian.
+//
+//   BinaryDatasetHeader (record_count is written last and stays 0 while the file is being filled)
+//   record_count records of record_size bytes:
+//     uint8 x_plane[(dim * dim + 7) / 8]   bit c is cell c = row * dim + col, as in PackedBoard
+//     uint8 o_plane[(dim * dim + 7) / 8]
+//     int8  starting_player
+//     int8  winner
+//     uint8 symmetry                       SYMMETRY_* applied to the played game
+//     zero padding up to a multiple of 8 bytes
+const char BINARY_DATASET_MAGIC[8] = {'H', 'E', 'X', 'B', 'R', 'E', 'C', '1'};
+const uint32_t BINARY_DATASET_VERSION = 1;
+
+struct BinaryDatasetHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t board_dim;
+    uint32_t record_size;
+    uint32_t header_size;   // Offset of record 0
+    uint64_t record_count;
+    uint64_t seed;          // Config seed the games were played from
+    uint64_t reserved[3];
+};
+
+static_assert(sizeof(BinaryDatasetHeader) == 64, "BinaryDatasetHeader layout changed");
+
+uint32_t binary_plane_bytes(int board_dim) {
+    return (board_dim * board_dim + 7) / 8;
+}
+
+uint32_t binary_record_size(int board_dim) {
+    return (2 * binary_plane_bytes(board_dim) + 3 + 7) / 8 * 8;
+}
+
+// The planes are the low bytes of PackedBoard's little-endian words, so both directions are copies
+void encode_binary_record(const GameRecord &game, int board_dim, uint8_t *record) {
+    uint32_t plane = binary_plane_bytes(board_dim);
+    std::memset(record, 0, binary_record_size(board_dim));
+    std::memcpy(record, game.board.x, plane);
+    std::memcpy(record + plane, game.board.o, plane);
+    record[2 * plane] = static_cast<uint8_t>(game.starting_player);
+    record[2 * plane + 1] = static_cast<uint8_t>(game.winner);
+    record[2 * plane + 2] = static_cast<uint8_t>(game.symmetry);
+}
+
+void decode_binary_record(const uint8_t *record, int board_dim, GameRecord &game) {
+    uint32_t plane = binary_plane_bytes(board_dim);
+    game.board = PackedBoard();
+    std::memcpy(game.board.x, record, plane);
+    std::memcpy(game.board.o, record + plane, plane);
+    game.starting_player = static_cast<int8_t>(record[2 * plane]);
+    game.winner = static_cast<int8_t>(record[2 * plane + 1]);
+    game.symmetry = record[2 * plane + 2];
+    game.split = 0;
+}
+
+// A .hxb file sized up front for a fixed number of records. Slots may be written in place from any
+// thread and in any order; commit() then publishes how many of them hold records and trims the rest.
+// On Linux the file is preallocated and memory-mapped, elsewhere slots are staged in memory and
+// written out on commit.
+class FixedRecordFile {
+public:
+    ~FixedRecordFile() {
+        release();
+    }
+
+    // Records go to {filename}.tmp, which commit() renames over filename. Until then, and whenever a
+    // step fails, no file with the dataset's name exists for a later sweep to mistake as finished.
+    bool open(const std::string &filename, int board_dim, uint64_t seed, uint64_t capacity) {
+        path = filename;
+        temp_path = filename + ".tmp";
+        committed = false;
+        header = {};
+        std::memcpy(header.magic, BINARY_DATASET_MAGIC, sizeof(header.magic));
+        header.version = BINARY_DATASET_VERSION;
+        header.board_dim = board_dim;
+        header.record_size = binary_record_size(board_dim);
+        header.header_size = sizeof(BinaryDatasetHeader);
+        header.seed = seed;
+        size = header.header_size + capacity * header.record_size;
+#ifdef __linux__
+        fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Failed to open the file: " << temp_path << std::endl;
+            return false;
+        }
+        // Reserve the blocks up front so page faults on the mapping never have to allocate
+        if (fallocate(fd, 0, 0, size) != 0 && ftruncate(fd, size) != 0) {
+            std::cerr << "Failed to size the file: " << filename << " (" << std::strerror(errno) << ")" << std::endl;
+            release();
+            return false;
+        }
+        void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Failed to map the file: " << filename << " (" << std::strerror(errno) << ")" << std::endl;
+            release();
+            return false;
+        }
+        data = static_cast<uint8_t*>(mapped);
+#else
+        staging.assign(size, 0);
+        data = staging.data();
+#endif
+        std::memcpy(data, &header, sizeof(header));  // record_count stays 0 until commit
+        return true;
+    }
+
+    uint8_t *slot(uint64_t index) {
+        return data + header.header_size + index * header.record_size;
+    }
+
+    // Call once every writer is done with its slots
+    bool commit(uint64_t record_count) {
+        header.record_count = record_count;
+        uint64_t used = header.header_size + record_count * header.record_size;
+        bool ok = data != nullptr;
+#ifdef __linux__
+        // Records reach the file before the header that makes them visible
+        ok = ok && msync(data, size, MS_SYNC) == 0;
+        if (ok) {
+            std::memcpy(data, &header, sizeof(header));
+            ok = msync(data, sizeof(header), MS_SYNC) == 0;
+        }
+        if (data != nullptr) {
+            munmap(data, size);
+            data = nullptr;
+        }
+        ok = ok && ftruncate(fd, used) == 0;
+        ok = ::close(fd) == 0 && ok;
+        fd = -1;
+#else
+        if (ok) {
+            std::memcpy(data, &header, sizeof(header));
+            std::ofstream outfile(temp_path, std::ios::binary | std::ios::trunc);
+            outfile.write(reinterpret_cast<const char*>(data), used);
+            outfile.close();
+            ok = static_cast<bool>(outfile);
+        }
+#endif
+        if (ok) {
+            std::error_code error;
+            std::filesystem::rename(temp_path, path, error);
+            ok = !error;
+        }
+        if (!ok) {
+            std::cerr << "Error writing file: " << path << std::endl;
+        }
+        committed = ok;
+        release();
+        return ok;
+    }
+
+private:
+    std::string path;
+    std::string temp_path;
+    bool committed = false;
+    BinaryDatasetHeader header = {};
+    uint64_t size = 0;
+    uint8_t *data = nullptr;
+#ifdef __linux__
+    int fd = -1;
+#else
+    std::vector<uint8_t> staging;
+#endif
+
+    void release() {
+#ifdef __linux__
+        if (data != nullptr) {
+            munmap(data, size);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = -1;
+#else
+        staging.clear();
+        staging.shrink_to_fit();
+#endif
+        data = nullptr;
+        if (!committed && !temp_path.empty()) {
+            std::remove(temp_path.c_str());
+        }
+        temp_path.clear();
+    }
+};
+
+// Insert-only set of 64-bit hashes in an open-addressing table of atomics, sized for a known number
+// of inserts. insert() is lock-free and reports whether the hash was new.
+class ConcurrentHashSet {
+public:
+    explicit ConcurrentHashSet(uint64_t max_entries) {
+        uint64_t capacity = 16;
+        while (capacity < 2 * max_entries) {
+            capacity <<= 1;
+        }
+        slots.reset(new std::atomic<uint64_t>[capacity]);
+        for (uint64_t i = 0; i < capacity; ++i) {
+            slots[i].store(0, std::memory_order_relaxed);
+        }
+        mask = capacity - 1;
+    }
+
+    bool insert(uint64_t hash) {
+        hash = hash != 0 ? hash : 1;  // 0 marks an empty slot
+        for (uint64_t i = hash & mask;; i = (i + 1) & mask) {
+            uint64_t current = slots[i].load(std::memory_order_relaxed);
+            if (current == 0 && slots[i].compare_exchange_strong(current, hash, std::memory_order_relaxed)) {
+                return true;
+            }
+            if (current == hash) {
+                return false;  // Present, or inserted by another thread just now
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    uint64_t mask;
+};
+
+struct FixedRecordStats {
+    uint64_t playouts = 0;
+    uint64_t too_few_open = 0;   // Failed the open-position threshold
+    uint64_t duplicates = 0;
+    uint64_t quota_rejected = 0; // Turned away by full strata
+    bool gave_up = false;        // Stopped on unfilled strata
+};
+
+// Unordered, throughput-first generation straight into a FixedRecordFile.
+//
+// Each worker plays its own blocks of game indices. Once a game passes the filters the worker
+// reserves a record slot with a single fetch_add on the shared record counter and encodes the game
+// into it, so no thread ever waits on another to write. Duplicates are rejected through a
+// ConcurrentHashSet of key hashes. Which games are kept and their order depend on thread timing,
+// so unlike PlayoutGenerator the output is not reproducible across runs. Returns the record count.
+uint64_t generate_fixed_records(const PlayoutSettings &settings, FixedRecordFile &file, uint64_t total_games,
+                                int num_threads, StratumQuotas *quotas, long long give_up_playouts,
+                                FixedRecordStats &stats) {
+    const uint64_t block_size = 256;
+    num_threads = std::max(1, num_threads);
+    ConcurrentHashSet keys(total_games + num_threads);
+    std::atomic<uint64_t> next_game(0);
+    std::atomic<uint64_t> next_slot(0);
+    std::atomic<uint64_t> last_accepted(0);  // Game index of a recent acceptance, for giving up
+    std::atomic<bool> done(total_games == 0);
+    std::atomic<uint64_t> playouts(0), too_few_open(0), duplicates(0), quota_rejected(0);
+    std::atomic<bool> gave_up(false);
+
+    auto worker = [&]() {
+        TraceLog::name_thread("fixed-record");
+        HexGame hg(settings.board_dim);
+        BoardSymmetry symmetry(settings.board_dim);
+        PlayoutResult result;
+        uint64_t local_playouts = 0, local_too_few_open = 0, local_duplicates = 0, local_quota_rejected = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+            uint64_t first = next_game.fetch_add(block_size, std::memory_order_relaxed);
+            TraceSpan span("playout block", "playout", first / block_size);
+            for (uint64_t game_index = first; game_index < first + block_size; ++game_index) {
+                if (done.load(std::memory_order_relaxed)) {
+                    break;
+                }
+                {
+                    PerfRegion region(PERF_STAGE_PLAYOUT);
+                    PlayoutGenerator::play(settings, hg, symmetry, game_index, result);
+                }
+                local_playouts++;
+                if (!result.valid) {
+                    local_too_few_open++;
+                    continue;
+                }
+
+                int stratum = -1;
+                if (quotas != nullptr) {
+                    if (game_index > last_accepted.load(std::memory_order_relaxed) + give_up_playouts) {
+                        gave_up.store(true);
+                        done.store(true);
+                        break;
+                    }
+                    stratum = quotas->stratum(result.winner, result.starting_player, result.game_length);
+                    if (!quotas->try_reserve(stratum)) {
+                        local_quota_rejected++;
+                        continue;  // Stratum already full
+                    }
+                }
+                bool inserted;
+                {
+                    PerfRegion region(PERF_STAGE_DEDUP);
+                    inserted = keys.insert(result.key_hash);
+                }
+                if (!inserted) {
+                    local_duplicates++;
+                    if (quotas != nullptr) {
+                        quotas->release(stratum);
+                    }
+                    continue;
+                }
+
+                uint64_t slot = next_slot.fetch_add(1, std::memory_order_relaxed);
+                if (slot >= total_games) {
+                    done.store(true);
+                    break;
+                }
+                GameRecord game = {result.board, result.starting_player, result.winner, SYMMETRY_IDENTITY, 0, game_index};
+                {
+                    PerfRegion region(PERF_STAGE_WRITE);
+                    encode_binary_record(game, settings.board_dim, file.slot(slot));
+                }
+                last_accepted.store(game_index, std::memory_order_relaxed);
+                if (slot + 1 == total_games) {
+                    done.store(true);
+                }
+            }
+        }
+        playouts += local_playouts;
+        too_few_open += local_too_few_open;
+        duplicates += local_duplicates;
+        quota_rejected += local_quota_rejected;
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; ++t) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    stats.playouts = playouts;
+    stats.too_few_open = too_few_open;
+    stats.duplicates = duplicates;
+    stats.quota_rejected = quota_rejected;
+    stats.gave_up = gave_up;
+    return std::min<uint64_t>(next_slot, total_games);
+}
+
+// Binary export for Graph Tsetlin Machine training.
+//
+// The hex grid topology only depends on the board dimension, so it is written once per dim to
+// graph_topology_{dim}x{dim}.bin. Each dataset then gets a {dataset}.graph.bin file holding only
+// fixed-size per-sample node symbols, so the loader can mmap it and index records directly.
+// All integers are little-endian.
+//
+// Topology file:
+//   GraphTopologyHeader
+//   uint32 edge_offsets[node_count + 1]   CSR row offsets, node id = row * dim + col
+//   uint32 edge_targets[edge_count]
+//   uint8  edge_types[edge_count]         index into HexGame::neighbors (0..5)
+//
+// Samples file:
+//   GraphSamplesHeader (record_count is patched in when the file is closed)
+//   record_count records of record_size bytes:
+//     uint16 group_ids[node_count]        only if GRAPH_FLAG_GROUP_IDS, 0 for empty cells
+//     uint8  node_symbols[node_count]     GRAPH_SYMBOL_* bits
+//     int8   starting_player
+//     int8   winner
+//     zero padding up to a multiple of 8 bytes
+const char GRAPH_TOPOLOGY_MAGIC[8] = {'H', 'E', 'X', 'G', 'T', 'O', 'P', '1'};
+const char GRAPH_SAMPLES_MAGIC[8] = {'H', 'E', 'X', 'G', 'N', 'O', 'D', '1'};
+const uint32_t GRAPH_FORMAT_VERSION = 1;
+const uint32_t GRAPH_FLAG_GROUP_IDS = 1;
+
+const uint8_t GRAPH_SYMBOL_X = 1 << 0;
+const uint8_t GRAPH_SYMBOL_O = 1 << 1;
+const uint8_t GRAPH_SYMBOL_TOP_EDGE = 1 << 2;     // Row 0, player X's start edge
+const uint8_t GRAPH_SYMBOL_BOTTOM_EDGE = 1 << 3;  // Last row, player X's goal edge
+const uint8_t GRAPH_SYMBOL_LEFT_EDGE = 1 << 4;    // Column 0, player O's start edge
+const uint8_t GRAPH_SYMBOL_RIGHT_EDGE = 1 << 5;   // Last column, player O's goal edge
+
+struct GraphTopologyHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t board_dim;
+    uint32_t node_count;
+    uint32_t edge_count;
+    uint32_t reserved[2];
+};
+
+struct GraphSamplesHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t board_dim;
+    uint32_t node_count;
+    uint32_t record_size;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t record_count;
+};
+
+static_assert(sizeof(GraphTopologyHeader) == 32, "GraphTopologyHeader layout changed");
+static_assert(sizeof(GraphSamplesHeader) == 40, "GraphSamplesHeader layout changed");
+
+class GraphExporter {
+public:
+    int board_dim = 0;
+    bool with_group_ids = false;
+    uint32_t record_size = 0;
+    uint64_t record_count = 0;
+    std::vector<uint8_t> edge_symbols;  // Static board-edge bits per node
+    std::vector<uint8_t> record;
+    std::string path;
+    std::ofstream outfile;
+
+    // Write the topology file for this dim unless it is already there. It is written under a temporary
+    // name and renamed when complete, so a file torn by an interrupted run is never reused.
+    static bool write_topology(const std::string &filename, int dim) {
+        if (std::filesystem::exists(filename)) {
+            return true;
+        }
+
+        HexGame hg(dim);
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> targets;
+        std::vector<uint8_t> types;
+        offsets.push_back(0);
+        for (int i = 0; i < dim; ++i) {
+            for (int j = 0; j < dim; ++j) {
+                int position = (i+1)*(dim+2) + j + 1;
+                for (int k = 0; k < 6; ++k) {
+                    int neighbor = position + hg.neighbors[k];
+                    int row = neighbor / (dim + 2) - 1;
+                    int col = neighbor % (dim + 2) - 1;
+                    if (row < 0 || row >= dim || col < 0 || col >= dim) {
+                        continue;
+                    }
+                    targets.push_back(row * dim + col);
+                    types.push_back(k);
+                }
+                offsets.push_back(targets.size());
+            }
+        }
+
+        std::string temp_filename = filename + ".tmp";
+        std::ofstream outfile(temp_filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            std::cerr << "Failed to open graph topology file: " << temp_filename << std::endl;
+            return false;
+        }
+
+        GraphTopologyHeader header = {};
+        std::memcpy(header.magic, GRAPH_TOPOLOGY_MAGIC, sizeof(header.magic));
+        header.version = GRAPH_FORMAT_VERSION;
+        header.board_dim = dim;
+        header.node_count = dim * dim;
+        header.edge_count = targets.size();
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        outfile.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        outfile.write(reinterpret_cast<const char*>(targets.data()), targets.size() * sizeof(uint32_t));
+        outfile.write(reinterpret_cast<const char*>(types.data()), types.size());
+        outfile.close();
+        std::error_code error;
+        if (outfile) {
+            std::filesystem::rename(temp_filename, filename, error);
+        }
+        if (!outfile || error) {
+            std::cerr << "Error writing graph topology file: " << filename << std::endl;
+            std::filesystem::remove(temp_filename, error);
+            return false;
+        }
+        return true;
+    }
+
+    bool open(const std::string &filename, int dim, bool group_ids) {
+        board_dim = dim;
+        with_group_ids = group_ids;
+        record_count = 0;
+        path = filename;
+
+        int node_count = dim * dim;
+        record_size = node_count + 2;
+        if (with_group_ids) {
+            record_size += node_count * sizeof(uint16_t);
+        }
+        record_size = (record_size + 7) & ~7u;
+        record.assign(record_size, 0);
+
+        edge_symbols.assign(node_count, 0);
+        for (int i = 0; i < dim; ++i) {
+            for (int j = 0; j < dim; ++j) {
+                uint8_t symbols = 0;
+                if (i == 0) symbols |= GRAPH_SYMBOL_TOP_EDGE;
+                if (i == dim - 1) symbols |= GRAPH_SYMBOL_BOTTOM_EDGE;
+                if (j == 0) symbols |= GRAPH_SYMBOL_LEFT_EDGE;
+                if (j == dim - 1) symbols |= GRAPH_SYMBOL_RIGHT_EDGE;
+                edge_symbols[i*dim + j] = symbols;
+            }
+        }
+
+        outfile.open(filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            std::cerr << "Failed to open graph samples file: " << filename << std::endl;
+            return false;
+        }
+        write_header();
+        return true;
+    }
+
+    void write(HexGame &hg, int starting_player, int winner) {
+        int node_count = board_dim * board_dim;
+        uint8_t *symbols = record.data();
+        if (with_group_ids) {
+            std::vector<int> groups = hg.stone_groups();
+            for (int n = 0; n < node_count; ++n) {
+                uint16_t group = groups[n];
+                std::memcpy(record.data() + n * sizeof(uint16_t), &group, sizeof(group));
+            }
+            symbols += node_count * sizeof(uint16_t);
+        }
+
+        for (int i = 0; i < board_dim; ++i) {
+            for (int j = 0; j < board_dim; ++j) {
+                int position = (i+1)*(board_dim+2) + j + 1;
+                uint8_t value = edge_symbols[i*board_dim + j];
+                if (hg.board[position*2]) value |= GRAPH_SYMBOL_X;
+                if (hg.board[position*2 + 1]) value |= GRAPH_SYMBOL_O;
+                symbols[i*board_dim + j] = value;
+            }
+        }
+        symbols[node_count] = static_cast<int8_t>(starting_player);
+        symbols[node_count + 1] = static_cast<int8_t>(winner);
+
+        outfile.write(reinterpret_cast<const char*>(record.data()), record_size);
+        record_count++;
+    }
+
+    // False if any write failed, in which case the header's record count cannot be trusted
+    bool close() {
+        if (!outfile.is_open()) {
+            return true;
+        }
+        // Rewrite the header now that the record count is known
+        outfile.seekp(0);
+        write_header();
+        outfile.close();
+        return static_cast<bool>(outfile);
+    }
+
+private:
+    void write_header() {
+        GraphSamplesHeader header = {};
+        std::memcpy(header.magic, GRAPH_SAMPLES_MAGIC, sizeof(header.magic));
+        header.version = GRAPH_FORMAT_VERSION;
+        header.board_dim = board_dim;
+        header.node_count = board_dim * board_dim;
+        header.record_size = record_size;
+        header.flags = with_group_ids ? GRAPH_FLAG_GROUP_IDS : 0;
+        header.record_count = record_count;
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+};
+
+// Bit-packed convolution patches for convolutional Tsetlin machines and CNN baselines.
+//
+// A patch_size x patch_size window slides over the board with the given stride. The board is
+// padded following the hex-edge convention used by HexGame::connected: cells above or below the
+// board count as X stones (X connects top to bottom), cells left or right of it as O stones, and
+// corner cells as both. Each patch is a bit string of
+//   [X plane, patch_size^2 bits][O plane, patch_size^2 bits]
+//   [row position, patches_per_row - 1 thermometer bits][column position, patches_per_row - 1 thermometer bits]
+// stored in words_per_patch little-endian uint64 words (bit 0 of word 0 first).
+//
+// File {dataset}.patches.bin:
+//   PatchSamplesHeader (record_count is patched in when the file is closed)
+//   record_count records of record_size bytes:
+//     uint64 patch_words[patches_per_row^2 * words_per_patch]   patches in row-major window order
+//     int8   starting_player
+//     int8   winner
+//     zero padding up to a multiple of 8 bytes
+const char PATCH_SAMPLES_MAGIC[8] = {'H', 'E', 'X', 'P', 'A', 'T', 'C', '1'};
+const uint32_t PATCH_FORMAT_VERSION = 1;
+
+struct PatchSamplesHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t board_dim;
+    uint32_t patch_size;
+    uint32_t stride;
+    uint32_t padding;
+    uint32_t patches_per_row;
+    uint32_t patch_bits;
+    uint32_t words_per_patch;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t record_count;
+};
+
+static_assert(sizeof(PatchSamplesHeader) == 56, "PatchSamplesHeader layout changed");
+
+class PatchExporter {
+public:
+    int board_dim = 0;
+    int patch_size = 0;
+    int stride = 0;
+    int padding = 0;
+    int patches_per_row = 0;
+    int patch_bits = 0;
+    int words_per_patch = 0;
+    uint32_t record_size = 0;
+    uint64_t record_count = 0;
+    std::vector<uint64_t> position_template;  // Thermometer bits for every patch, copied into each record
+    std::vector<uint64_t> x_rows;             // Padded board rows as bitmasks, bit c = padded column c
+    std::vector<uint64_t> o_rows;
+    std::vector<uint8_t> record;
+    std::string path;
+    std::ofstream outfile;
+
+    bool open(const std::string &filename, int dim, int size, int step, int pad) {
+        path = filename;
+        board_dim = dim;
+        patch_size = size;
+        stride = step;
+        padding = pad;
+        record_count = 0;
+
+        int padded_dim = dim + 2*pad;
+        if (size < 1 || step < 1 || pad < 0 || padded_dim < size || padded_dim > 64) {
+            std::cerr << "Invalid patch configuration: size " << size << ", stride " << step
+                      << ", padding " << pad << " for " << dim << "x" << dim << std::endl;
+            return false;
+        }
+
+        patches_per_row = (padded_dim - size) / step + 1;
+        patch_bits = 2*size*size + 2*(patches_per_row - 1);
+        words_per_patch = (patch_bits + 63) / 64;
+        int patch_words = patches_per_row * patches_per_row * words_per_patch;
+
+        record_size = patch_words * sizeof(uint64_t) + 2;
+        record_size = (record_size + 7) & ~7u;
+        record.assign(record_size, 0);
+        x_rows.assign(padded_dim, 0);
+        o_rows.assign(padded_dim, 0);
+
+        // Patch positions never change, so their thermometer codes are built once
+        position_template.assign(patch_words, 0);
+        for (int pi = 0; pi < patches_per_row; ++pi) {
+            for (int pj = 0; pj < patches_per_row; ++pj) {
+                uint64_t *words = &position_template[(pi*patches_per_row + pj) * words_per_patch];
+                int offset = 2*size*size;
+                for (int t = 0; t < patches_per_row - 1; ++t) {
+                    put_bits(words, offset + t, pi > t ? 1 : 0, 1);
+                    put_bits(words, offset + patches_per_row - 1 + t, pj > t ? 1 : 0, 1);
+                }
+            }
+        }
+
+        outfile.open(filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            std::cerr << "Failed to open patch samples file: " << filename << std::endl;
+            return false;
+        }
+        write_header();
+        return true;
+    }
+
+    void write(HexGame &hg, int starting_player, int winner) {
+        int padded_dim = board_dim + 2*padding;
+        uint64_t padded_mask = padded_dim == 64 ? ~0ULL : (1ULL << padded_dim) - 1;
+        uint64_t side_mask = padded_mask & ~(((1ULL << board_dim) - 1) << padding);
+
+        // Pack the board into one word per padded row so each window row is a single shift and mask
+        for (int r = 0; r < padded_dim; ++r) {
+            int i = r - padding;
+            if (i < 0 || i >= board_dim) {
+                x_rows[r] = padded_mask;
+                o_rows[r] = side_mask;
+                continue;
+            }
+            uint64_t x = 0;
+            uint64_t o = 0;
+            const int *row = &hg.board[((i+1)*(board_dim+2) + 1)*2];
+            for (int j = 0; j < board_dim; ++j) {
+                x |= static_cast<uint64_t>(row[j*2] != 0) << j;
+                o |= static_cast<uint64_t>(row[j*2 + 1] != 0) << j;
+            }
+            x_rows[r] = x << padding;
+            o_rows[r] = (o << padding) | side_mask;
+        }
+
+        uint64_t *words = reinterpret_cast<uint64_t*>(record.data());
+        std::memcpy(words, position_template.data(), position_template.size() * sizeof(uint64_t));
+        uint64_t window_mask = patch_size == 64 ? ~0ULL : (1ULL << patch_size) - 1;
+        int plane_bits = patch_size * patch_size;
+        for (int pi = 0; pi < patches_per_row; ++pi) {
+            for (int pj = 0; pj < patches_per_row; ++pj) {
+                uint64_t *patch = words + (pi*patches_per_row + pj) * words_per_patch;
+                int top = pi * stride;
+                int left = pj * stride;
+                for (int wr = 0; wr < patch_size; ++wr) {
+                    put_bits(patch, wr*patch_size, (x_rows[top + wr] >> left) & window_mask, patch_size);
+                    put_bits(patch, plane_bits + wr*patch_size, (o_rows[top + wr] >> left) & window_mask, patch_size);
+                }
+            }
+        }
+
+        uint8_t *outcome = record.data() + position_template.size() * sizeof(uint64_t);
+        outcome[0] = static_cast<int8_t>(starting_player);
+        outcome[1] = static_cast<int8_t>(winner);
+
+        outfile.write(reinterpret_cast<const char*>(record.data()), record_size);
+        record_count++;
+    }
+
+    // False if any write failed, in which case the header's record count cannot be trusted
+    bool close() {
+        if (!outfile.is_open()) {
+            return true;
+        }
+        outfile.seekp(0);
+        write_header();
+        outfile.close();
+        return static_cast<bool>(outfile);
+    }
+
+private:
+    // OR the low `count` bits of `value` into the bit string at `offset`
+    static void put_bits(uint64_t *words, int offset, uint64_t value, int count) {
+        int word = offset / 64;
+        int shift = offset % 64;
+        words[word] |= value << shift;
+        if (shift + count > 64) {
+            words[word + 1] |= value >> (64 - shift);
+        }
+    }
+
+    void write_header() {
+        PatchSamplesHeader header = {};
+        std::memcpy(header.magic, PATCH_SAMPLES_MAGIC, sizeof(header.magic));
+        header.version = PATCH_FORMAT_VERSION;
+        header.board_dim = board_dim;
+        header.patch_size = patch_size;
+        header.stride = stride;
+        header.padding = padding;
+        header.patches_per_row = patches_per_row;
+        header.patch_bits = patch_bits;
+        header.words_per_patch = words_per_patch;
+        header.record_size = record_size;
+        header.record_count = record_count;
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+};
+
+// Every-ply position stream. Instead of one board per game, each accepted game is stored once as its
+// move list, and every ply_stride-th intermediate position is implied by a prefix of it. Writing a
+// game is O(1) per position (one byte per stone) rather than O(dim^2).
+//
+// File {dataset}.positions.bin:
+//   PositionStreamHeader (counts are patched in when the file is closed)
+//   game_count games, each
+//     uint16 length               plies in the full game, before any moves_before_end truncation
+//     int8   starting_player
+//     int8   winner
+//     uint8  moves[length]        logical cell index row * dim + col, in play order
+//
+// Positions of a game are the plies p = ply_stride, 2*ply_stride, ... <= length. The board at ply p
+// holds moves[0..p), move k played by starting_player ^ (k & 1). Its labels are the game's winner,
+// side to move starting_player ^ (p & 1) and plies remaining length - p.
+const char POSITION_STREAM_MAGIC[8] = {'H', 'E', 'X', 'P', 'O', 'S', 'N', '1'};
+const uint32_t POSITION_FORMAT_VERSION = 1;
+
+struct PositionStreamHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t board_dim;
+    uint32_t ply_stride;
+    uint32_t reserved;
+    uint64_t game_count;
+    uint64_t position_count;
+};
+
+static_assert(sizeof(PositionStreamHeader) == 40, "PositionStreamHeader layout changed");
+
+// Encode one game in the layout above, which the game corpus shares
+void encode_game_moves(const std::vector<int> &moves, int starting_player, int winner, std::vector<uint8_t> &record) {
+    uint16_t length = moves.size();
+    record.resize(4 + moves.size());
+    std::memcpy(record.data(), &length, sizeof(length));
+    record[2] = static_cast<int8_t>(starting_player);
+    record[3] = static_cast<int8_t>(winner);
+    for (size_t k = 0; k < moves.size(); ++k) {
+        record[4 + k] = moves[k];
+    }
+}
+
+class PositionStreamExporter {
+public:
+    int board_dim = 0;
+    int ply_stride = 1;
+    uint64_t game_count = 0;
+    uint64_t position_count = 0;
+    std::vector<uint8_t> record;
+    std::string path;
+    std::ofstream outfile;
+
+    bool open(const std::string &filename, int dim, int stride) {
+        path = filename;
+        board_dim = dim;
+        ply_stride = stride;
+        game_count = 0;
+        position_count = 0;
+        if (dim > MAX_PACKED_DIM || stride < 1) {
+            std::cerr << "Invalid position stream configuration: stride " << stride << " for " << dim << "x" << dim << std::endl;
+            return false;
+        }
+
+        outfile.open(filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            std::cerr << "Failed to open position stream file: " << filename << std::endl;
+            return false;
+        }
+        write_header();
+        return true;
+    }
+
+    void write(const std::vector<int> &moves, int starting_player, int winner) {
+        encode_game_moves(moves, starting_player, winner, record);
+        outfile.write(reinterpret_cast<const char*>(record.data()), record.size());
+        game_count++;
+        position_count += moves.size() / ply_stride;
+    }
+
+    // False if any write failed, in which case the header's counts cannot be trusted
+    bool close() {
+        if (!outfile.is_open()) {
+            return true;
+        }
+        outfile.seekp(0);
+        write_header();
+        outfile.close();
+        return static_cast<bool>(outfile);
+    }
+
+private:
+    void write_header() {
+        PositionStreamHeader header = {};
+        std::memcpy(header.magic, POSITION_STREAM_MAGIC, sizeof(header.magic));
+        header.version = POSITION_FORMAT_VERSION;
+        header.board_dim = board_dim;
+        header.ply_stride = ply_stride;
+        header.game_count = game_count;
+        header.position_count = position_count;
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+};
+
+// Function to generate a unique timestamp for the filename
+std::string generate_timestamp(bool detailed = false) {
+    // Get current time
+    std::time_t t = std::time(nullptr);
+    std::tm* time_ptr = std::localtime(&t);
+
+    std::ostringstream oss;
+
+    if (detailed) {
+        // If detailed timestamp is requested: include year, month, day, hour, minute, second
+        oss << std::put_time(time_ptr, "%Y%m%d:%H%M%S");
+
+        // Add milliseconds for more precision
+        auto now = std::chrono::system_clock::now();
+        auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+        oss << "." << std::setw(3) << std::setfill('0') << milliseconds.count();
+    } else {
+        // Simpler timestamp with hour, minute, second
+        oss << std::put_time(time_ptr, "%H%M%S");  // Hour, minute, second
+    }
+
+    return oss.str();
+}
+
+const char SKETCH_MAGIC[8] = {'H', 'E', 'X', 'S', 'K', 'C', 'H', '1'};
+const uint32_t SKETCH_VERSION = 1;
+const int SKETCH_HLL_PRECISION = 14;     // 2^14 registers, about 0.8% standard error
+const int SKETCH_CMS_DEPTH = 4;
+const int SKETCH_CMS_WIDTH = 8192;       // Overcounts by at most records / 3000 with 98% confidence
+const int SKETCH_HOT_BOARDS = 16;        // Most duplicated boards kept as candidates
+const int SKETCH_MAX_LENGTH = MAX_PACKED_DIM * MAX_PACKED_DIM;
+
+// Header of a .sketch file; the sketch arrays follow in declaration order
+struct SketchHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t board_dim;          // 0 once shards of different sizes have been merged
+    uint32_t hll_precision;
+    uint32_t cms_depth;
+    uint32_t cms_width;
+    uint32_t hot_count;
+    uint64_t records;
+    uint64_t shards;
+    uint64_t reserved[2];
+};
+static_assert(sizeof(SketchHeader) == 64, "SketchHeader layout changed");
+
+// Mergeable summary of a dataset shard: a HyperLogLog of distinct boards, a count-min sketch of
+// board frequencies with the most duplicated boards as candidates, and exact histograms of game
+// length (stones on the final board) and of outcomes by starting player. Merging two sketches gives
+// the sketch of the concatenated shards, so sweep-level statistics never need the data itself.
+class DatasetSketch {
+public:
+    struct HotBoard {
+        PackedBoard board;
+        uint64_t count;          // Count-min estimate, never below the true count
+    };
+
+    uint32_t board_dim = 0;
+    uint64_t records = 0;
+    uint64_t shards = 0;
+    std::vector<uint64_t> lengths = std::vector<uint64_t>(SKETCH_MAX_LENGTH + 1, 0);
+    uint64_t outcomes[2][2] = {};  // [starting player][winner]
+    std::vector<HotBoard> hot;
+
+    DatasetSketch() : registers(1 << SKETCH_HLL_PRECISION, 0), counters(SKETCH_CMS_DEPTH * SKETCH_CMS_WIDTH, 0) {}
+
+    void add(const GameRecord &game, int dim) {
+        board_dim = dim;
+        shards = std::max<uint64_t>(shards, 1);
+        records++;
+        uint64_t h = game.board.hash();
+        uint64_t index = h & (registers.size() - 1);
+        uint8_t rank = count_trailing_zeros((h >> SKETCH_HLL_PRECISION) | (1ULL << (64 - SKETCH_HLL_PRECISION))) + 1;
+        registers[index] = std::max(registers[index], rank);
+
+        uint64_t estimate = UINT64_MAX;
+        for (int row = 0; row < SKETCH_CMS_DEPTH; ++row) {
+            uint32_t &counter = counters[counter_index(h, row)];
+            counter++;
+            estimate = std::min<uint64_t>(estimate, counter);
+        }
+        if (estimate > 1) {
+            offer_hot({game.board, estimate});
+        }
+
+        int length = 0;
+        for (int w = 0; w < 4; ++w) {
+            length += count_set_bits(game.board.x[w]) + count_set_bits(game.board.o[w]);
+        }
+        lengths[length]++;
+        if (game.starting_player >= 0 && game.starting_player < 2 && game.winner >= 0 && game.winner < 2) {
+            outcomes[game.starting_player][game.winner]++;
+        }
+    }
+
+    void merge(const DatasetSketch &other) {
+        board_dim = (shards == 0 || board_dim == other.board_dim) ? other.board_dim : 0;  // 0 for mixed sizes
+        records += other.records;
+        shards += other.shards;
+        for (size_t r = 0; r < registers.size(); ++r) {
+            registers[r] = std::max(registers[r], other.registers[r]);
+        }
+        for (size_t c = 0; c < counters.size(); ++c) {
+            counters[c] += other.counters[c];
+        }
+        for (size_t l = 0; l < lengths.size(); ++l) {
+            lengths[l] += other.lengths[l];
+        }
+        for (int p = 0; p < 2; ++p) {
+            for (int w = 0; w < 2; ++w) {
+                outcomes[p][w] += other.outcomes[p][w];
+            }
+        }
+        // Counts only grow by merging, so re-estimate every candidate from the merged counters
+        std::vector<HotBoard> candidates = hot;
+        candidates.insert(candidates.end(), other.hot.begin(), other.hot.end());
+        hot.clear();
+        for (HotBoard &candidate : candidates) {
+            candidate.count = estimate(candidate.board.hash());
+            offer_hot(candidate);
+        }
+    }
+
+    // HyperLogLog estimate with the linear-counting correction for small cardinalities
+    double distinct_estimate() const {
+        double m = registers.size();
+        double sum = 0.0;
+        int zeros = 0;
+        for (uint8_t rank : registers) {
+            sum += std::ldexp(1.0, -rank);
+            zeros += rank == 0;
+        }
+        double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+        if (estimate <= 2.5 * m && zeros > 0) {
+            estimate = m * std::log(m / zeros);
+        }
+        return std::min<double>(estimate, records);
+    }
+
+    uint64_t estimate(uint64_t h) const {
+        uint64_t count = UINT64_MAX;
+        for (int row = 0; row < SKETCH_CMS_DEPTH; ++row) {
+            count = std::min<uint64_t>(count, counters[counter_index(h, row)]);
+        }
+        return count;
+    }
+
+    bool save(const std::string &filename) const {
+        std::ofstream outfile(filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            std::cerr << "Failed to open sketch file: " << filename << std::endl;
+            return false;
+        }
+        SketchHeader header = {};
+        std::memcpy(header.magic, SKETCH_MAGIC, sizeof(header.magic));
+        header.version = SKETCH_VERSION;
+        header.board_dim = board_dim;
+        header.hll_precision = SKETCH_HLL_PRECISION;
+        header.cms_depth = SKETCH_CMS_DEPTH;
+        header.cms_width = SKETCH_CMS_WIDTH;
+        header.hot_count = hot.size();
+        header.records = records;
+        header.shards = shards;
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        outfile.write(reinterpret_cast<const char*>(registers.data()), registers.size());
+        outfile.write(reinterpret_cast<const char*>(counters.data()), counters.size() * sizeof(uint32_t));
+        outfile.write(reinterpret_cast<const char*>(lengths.data()), lengths.size() * sizeof(uint64_t));
+        outfile.write(reinterpret_cast<const char*>(outcomes), sizeof(outcomes));
+        outfile.write(reinterpret_cast<const char*>(hot.data()), hot.size() * sizeof(HotBoard));
+        return static_cast<bool>(outfile);
+    }
+
+    bool load(const std::string &filename) {
+        std::ifstream infile(filename, std::ios::binary);
+        SketchHeader header = {};
+        if (!infile.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, SKETCH_MAGIC, sizeof(header.magic)) != 0) {
+            std::cerr << "Not a sketch file: " << filename << std::endl;
+            return false;
+        }
+        if (header.version != SKETCH_VERSION || header.hll_precision != SKETCH_HLL_PRECISION ||
+            header.cms_depth != SKETCH_CMS_DEPTH || header.cms_width != SKETCH_CMS_WIDTH ||
+            header.hot_count > SKETCH_HOT_BOARDS) {
+            std::cerr << "Unsupported sketch parameters in " << filename << std::endl;
+            return false;
+        }
+        board_dim = header.board_dim;
+        records = header.records;
+        shards = header.shards;
+        hot.resize(header.hot_count);
+        infile.read(reinterpret_cast<char*>(registers.data()), registers.size());
+        infile.read(reinterpret_cast<char*>(counters.data()), counters.size() * sizeof(uint32_t));
+        infile.read(reinterpret_cast<char*>(lengths.data()), lengths.size() * sizeof(uint64_t));
+        infile.read(reinterpret_cast<char*>(outcomes), sizeof(outcomes));
+        infile.read(reinterpret_cast<char*>(hot.data()), hot.size() * sizeof(HotBoard));
+        if (!infile) {
+            std::cerr << "Truncated sketch file: " << filename << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> registers;   // HyperLogLog, the highest rank seen per bucket
+    std::vector<uint32_t> counters;   // Count-min, SKETCH_CMS_DEPTH rows of SKETCH_CMS_WIDTH
+
+    static size_t counter_index(uint64_t h, int row) {
+        return row * SKETCH_CMS_WIDTH + PackedBoard::mix64(h + (row + 1) * 0x9E3779B97F4A7C15ULL) % SKETCH_CMS_WIDTH;
+    }
+
+    // Keep the SKETCH_HOT_BOARDS highest estimates, one entry per board
+    void offer_hot(const HotBoard &candidate) {
+        for (HotBoard &entry : hot) {
+            if (entry.board == candidate.board) {
+                entry.count = std::max(entry.count, candidate.count);
+                return;
+            }
+        }
+        if (hot.size() < SKETCH_HOT_BOARDS) {
+            hot.push_back(candidate);
+            return;
+        }
+        auto lowest = std::min_element(hot.begin(), hot.end(), [](const HotBoard &a, const HotBoard &b) {
+            return a.count < b.count;
+        });
+        if (lowest->count < candidate.count) {
+            *lowest = candidate;
+        }
+    }
+};
+
+// metadata_{dataset}.csv -> metadata_{dataset}.sketch
+std::string sketch_filename(const std::string &metadata_filename) {
+    std::string base = metadata_filename;
+    if (base.size() > 4 && base.compare(base.size() - 4, 4, ".csv") == 0) {
+        base.erase(base.size() - 4);
+    }
+    return base + ".sketch";
+}
+
+// Function to analyze the dataset and return metadata for documentation. A chunked dataset is
+// analyzed across all of its chunk files, so duplicates between chunks are not counted as unique.
+std::tuple<int, int, int, int> analyze_game_file(const std::vector<std::string> &filenames, const std::string &format) {
+    std::string line;
+    int wins_player_X = 0;
+    int wins_player_O = 0;
+    int total_games = 0;
+
+    // Use an unordered_set to track unique games
+    std::unordered_set<std::string> unique_games;
+
+    for (const auto& filename : filenames) {
+        std::ifstream infile(filename, format == "binary" ? std::ios::binary : std::ios::in);
+        if (!infile.is_open()) {
+            std::cerr << "Failed to open the file: " << filename << std::endl;
+            continue;
+        }
+
+        if (format == "binary") {
+            BinaryDatasetHeader header = {};
+            infile.read(reinterpret_cast<char*>(&header), sizeof(header));
+            std::vector<uint8_t> record(header.record_size);
+            GameRecord game = {};
+            infile.seekg(header.header_size);
+            for (uint64_t r = 0; r < header.record_count && infile.read(reinterpret_cast<char*>(record.data()), record.size()); ++r) {
+                decode_binary_record(record.data(), header.board_dim, game);
+                unique_games.insert(game.board.key());
+                wins_player_X += game.winner == 0;
+                wins_player_O += game.winner == 1;
+                total_games++;
+            }
+            continue;
+        }
+
+        // Read and process the file
+        bool first_line = true;  // Skip the first line (header)
+        int extra_columns = 0;
+        while (std::getline(infile, line)) {
+            if (first_line) {
+                first_line = false;
+                // Optional columns such as symmetry and game_index follow the winner
+                size_t winner_column = line.find(",winner");
+                if (winner_column != std::string::npos) {
+                    extra_columns = std::count(line.begin() + winner_column + 1, line.end(), ',');
+                }
+                continue;
+            }
+
+            // Strip the optional columns, they are not part of the game
+            for (int c = 0; c < extra_columns; ++c) {
+                line.erase(line.find_last_of(','));
+            }
+
+            std::string board_state;
+            std::string winner_str;
+            if (format == "coord") {
+                // Extract the board state and winner
+                std::stringstream ss(line);
+                std::string cell;
+                board_state.clear();
+
+                // Concatenate all cell values for uniqueness
+                while (std::getline(ss, cell, ',')) {
+                    board_state += cell;
+                }
+                winner_str = board_state.back();  // Last value is the winner
+                board_state.pop_back();  // Remove the winner from the state
+
+            } else {
+                // Non-coord format: extract board state and winner (the last column)
+                std::stringstream ss(line);
+                std::getline(ss, board_state, ',');
+                winner_str = line.substr(line.find_last_of(',') + 1);
+            }
+
+            // Add the board state to the set of unique games
+            unique_games.insert(board_state);
+
+            // Increment the winner count
+            int winner = std::stoi(winner_str);
+            if (winner == 0) {
+                wins_player_X++;
+            } else if (winner == 1) {
+                wins_player_O++;
+            }
+
+            total_games++;
+        }
+
+        infile.close();
+    }
+
+    int unique_games_count = unique_games.size();
+
+    // Return total games, unique games, wins for player X and O
+    return {total_games, unique_games_count, wins_player_X, wins_player_O};
+}
+
+// Removed moves of every accepted game of one split, for the metadata file. Under a memory budget
+// the log spills to a temporary file, keeping at most SPILL_BYTES of games in memory, and streams
+// the spilled games back when it is written.
+class RemovedMovesLog {
+public:
+    RemovedMovesLog() = default;
+    RemovedMovesLog(RemovedMovesLog&&) = default;
+
+    ~RemovedMovesLog() {
+        if (!spill_filename.empty()) {
+            spill_file.close();
+            std::remove(spill_filename.c_str());
+        }
+    }
+
+    void push_back(std::vector<int> &&moves) {
+        move_bytes += moves.capacity() * sizeof(int);
+        games.push_back(std::move(moves));
+        if (!spill_filename.empty() && bytes() > SPILL_BYTES) {
+            spill();
+        }
+    }
+
+    size_t size() const {
+        return spilled_games + games.size();
+    }
+
+    // Heap bytes of the games held in memory
+    uint64_t bytes() const {
+        return games.capacity() * sizeof(std::vector<int>) + move_bytes;
+    }
+
+    bool spilling() const {
+        return !spill_filename.empty();
+    }
+
+    // Move the games held in memory to `filename` and keep spilling there from now on
+    bool start_spilling(const std::string &filename) {
+        spill_file.open(filename, std::ios::binary | std::ios::trunc);
+        if (!spill_file.is_open()) {
+            std::cerr << "Failed to open spill file: " << filename << std::endl;
+            return false;
+        }
+        spill_filename = filename;
+        return spill();
+    }
+
+    // {{moves of game 0},{moves of game 1},...} in acceptance order
+    void write(std::ostream &out) const {
+        out << "{";
+        bool first = true;
+        auto write_game = [&](const int *moves, size_t count) {
+            out << (first ? "{" : ",{");
+            first = false;
+            for (size_t i = 0; i < count; ++i) {
+                out << (i ? "," : "") << moves[i];  // Already in correct logical index form
+            }
+            out << "}";
+        };
+        if (!spill_filename.empty()) {
+            std::ifstream infile(spill_filename, std::ios::binary);
+            std::vector<int> moves;
+            uint32_t count;
+            while (infile.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+                moves.resize(count);
+                infile.read(reinterpret_cast<char*>(moves.data()), count * sizeof(int));
+                write_game(moves.data(), count);
+            }
+        }
+        for (const auto& moves : games) {
+            write_game(moves.data(), moves.size());
+        }
+        out << "}";
+    }
+
+private:
+    static const uint64_t SPILL_BYTES = 1 << 20;
+
+    std::vector<std::vector<int>> games;
+    uint64_t move_bytes = 0;
+    std::string spill_filename;
+    std::ofstream spill_file;    // Per game: uint32 count, then count int moves
+    uint64_t spilled_games = 0;
+
+    bool spill() {
+        for (const auto& moves : games) {
+            uint32_t count = moves.size();
+            spill_file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            spill_file.write(reinterpret_cast<const char*>(moves.data()), count * sizeof(int));
+        }
+        spilled_games += games.size();
+        std::vector<std::vector<int>>().swap(games);
+        move_bytes = 0;
+        spill_file.flush();
+        return static_cast<bool>(spill_file);
+    }
+};
+
+// Function to save metadata including removed moves to a separate CSV file
+void save_metadata_with_removed_moves(const std::string &metadata_filename, const std::string &dataset_filename,
+                                      int board_dim, int total_games, int unique_games, int wins_player_X,
+                                      int wins_player_O, const std::string &format,
+                                      const RemovedMovesLog &removed_moves, int moves_before_end, uint64_t seed) {
+    std::ofstream outfile(metadata_filename);
+    if (!outfile.is_open()) {
+        std::cerr << "Failed to open metadata file: " << metadata_filename << std::endl;
+        return;
+    }
+
+    // Write metadata header
+    outfile << "Filename,Board Dimension,Total Games,Unique Games,Player X Wins,Player O Wins,Format,Timestamp,Moves Before End,Seed,Removed Moves\n";
+
+    // Write metadata content
+    outfile << dataset_filename << ","
+            << board_dim << "x" << board_dim << ","
+            << total_games << ","
+            << unique_games << ","
+            << wins_player_X << ","
+            << wins_player_O << ","
+            << format << ","
+            << generate_timestamp(true) << ","
+            << moves_before_end << ","
+            << seed << ",";
+
+    // Write removed moves for each game
+    removed_moves.write(outfile);
+    outfile << "\n";
+
+    outfile.close();
+}
+
+// Helper function to create a directory if it doesn't exist
+bool ensure_directory_exists(const std::string &directory) {
+    struct stat info;
+    if (stat(directory.c_str(), &info) != 0) {
+        // Directory does not exist, so create it
+        std::cout << "Creating directory: " << directory << std::endl;
+        #ifdef _WIN32
+            mkdir(directory.c_str());
+        #else
+            mkdir(directory.c_str(), 0777);  // UNIX-style
+        #endif
+        return true;
+    }
+    return false;
+}
+
+// Identifiers of the game engine and playout policy recorded with every dataset, bumped whenever
+// either changes the games a seed produces
+const char *ENGINE_ID = "hexgame-expanded-board-1";
+const char *POLICY_ID = "uniform-random-philox4x32-10";
+
+// CPU time of the whole process, user plus system, in seconds
+double process_cpu_seconds() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0.0;
+    }
+    auto ticks = [](const FILETIME &time) { return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+    return (ticks(kernel) + ticks(user)) / 1e7;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+// High-water mark of the process's resident memory so far
+uint64_t peak_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Resident memory of the process right now, 0 where it cannot be read
+uint64_t current_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    return K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#elif defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    uint64_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+// Restart the peak RSS measurement so that config_peak_rss_bytes covers only what follows. Only
+// Linux can do this (clear_refs resets VmHWM); elsewhere the process-wide peak is reported.
+bool reset_peak_rss() {
+#ifdef __linux__
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.close();
+    return !clear_refs.fail();
+#else
+    return false;
+#endif
+}
+
+uint64_t config_peak_rss_bytes() {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+        }
+    }
+#endif
+    return peak_rss_bytes();
+}
+
+// Heap allocation accounting. The global operator new and delete below always allocate with
+// malloc; while allocation_counting is on they also count allocations and track live and peak heap
+// bytes, using the allocator's usable size so that frees need no header.
+std::atomic<bool> allocation_counting(false);  // Set before any generation thread starts
+
+struct AllocationCounters {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocated_bytes{0};   // Total ever allocated
+    std::atomic<int64_t> live_bytes{0};         // Can dip below 0 for blocks allocated before counting started
+    std::atomic<int64_t> peak_live_bytes{0};    // Reset per config
+};
+
+AllocationCounters allocation_counters;
+
+inline size_t allocation_size(void *block) {
+#if defined(_WIN32)
+    return _msize(block);
+#elif defined(__APPLE__)
+    return malloc_size(block);
+#else
+    return malloc_usable_size(block);
+#endif
+}
+
+inline void count_allocation(void *block) {
+    int64_t size = allocation_size(block);
+    allocation_counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    allocation_counters.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    int64_t live = allocation_counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    int64_t peak = allocation_counters.peak_live_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !allocation_counters.peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+inline void *counted_allocate(std::size_t size) {
+    void *block = std::malloc(size ? size : 1);
+    if (block != nullptr && allocation_counting.load(std::memory_order_relaxed)) {
+        count_allocation(block);
+    }
+    return block;
+}
+
+inline void counted_free(void *block) {
+    if (block != nullptr && allocation_counting.load(std::memory_order_relaxed)) {
+        allocation_counters.live_bytes.fetch_sub(allocation_size(block), std::memory_order_relaxed);
+    }
+    std::free(block);
+}
+
+void *operator new(std::size_t size) {
+    void *block = counted_allocate(size);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_allocate(size);
+}
+
+void operator delete(void *block) noexcept { counted_free(block); }
+void operator delete[](void *block) noexcept { counted_free(block); }
+void operator delete(void *block, std::size_t) noexcept { counted_free(block); }
+void operator delete[](void *block, std::size_t) noexcept { counted_free(block); }
+void operator delete(void *block, const std::nothrow_t&) noexcept { counted_free(block); }
+void operator delete[](void *block, const std::nothrow_t&) noexcept { counted_free(block); }
+
+// Memory of one config: peak RSS, heap activity and the largest size reached by the structures
+// that grow with the config
+struct MemoryReport {
+    uint64_t peak_rss = 0;
+    bool peak_rss_per_config = false;  // False when peak_rss is the process-wide peak
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    int64_t peak_heap_bytes = 0;
+    uint64_t unique_games_bytes = 0;
+    uint64_t game_results_bytes = 0;
+    uint64_t removed_moves_bytes = 0;
+    bool compacted_keys = false;       // Budget switched deduplication to 64-bit hashes
+    bool spilled_removed_moves = false;
+
+    void start() {
+        peak_rss_per_config = reset_peak_rss();
+        allocations = allocation_counters.allocations;
+        allocated_bytes = allocation_counters.allocated_bytes;
+        allocation_counters.peak_live_bytes = allocation_counters.live_bytes.load();
+    }
+
+    void finish() {
+        peak_rss = config_peak_rss_bytes();
+        allocations = allocation_counters.allocations - allocations;
+        allocated_bytes = allocation_counters.allocated_bytes - allocated_bytes;
+        peak_heap_bytes = std::max<int64_t>(0, allocation_counters.peak_live_bytes);
+    }
+
+    void print(bool heap_counted) const {
+        const double mib = 1024.0 * 1024.0;
+        std::cout << " - Memory: peak RSS " << peak_rss / mib << " MiB" << (peak_rss_per_config ? "" : " (process)");
+        if (heap_counted) {
+            std::cout << ", peak heap " << peak_heap_bytes / mib << " MiB, " << allocations << " allocations of "
+                      << allocated_bytes / mib << " MiB";
+        }
+        std::cout << "; unique_games " << unique_games_bytes / mib << " MiB" << (compacted_keys ? " (compacted)" : "")
+                  << ", game_results " << game_results_bytes / mib << " MiB, removed_moves " << removed_moves_bytes / mib
+                  << " MiB" << (spilled_removed_moves ? " (spilled)" : "") << std::endl;
+    }
+};
+
+// Approximate heap bytes of a node-based hash set: buckets, nodes with a cached hash, and the
+// out-of-line buffers of long strings
+template <typename Key>
+uint64_t hash_set_bytes(const std::unordered_set<Key> &set, size_t heap_bytes_per_key) {
+    size_t node = sizeof(void*) + sizeof(Key) + sizeof(size_t);
+    return set.bucket_count() * sizeof(void*) + set.size() * (node + heap_bytes_per_key);
+}
+
+std::string host_name() {
+#ifdef _WIN32
+    const char *name = std::getenv("COMPUTERNAME");
+    return name != nullptr ? name : "";
+#else
+    char name[256] = {};
+    gethostname(name, sizeof(name) - 1);
+    return name;
+#endif
+}
+
+// CRC-32 of a whole file, as in chunk manifests; 0 if it cannot be read
+uint32_t file_crc32(const std::string &filename) {
+    std::ifstream infile(filename, std::ios::binary);
+    std::vector<char> buffer(1 << 20);
+    uint32_t crc = 0;
+    while (infile.read(buffer.data(), buffer.size()) || infile.gcount() > 0) {
+        crc = crc32_update(crc, buffer.data(), infile.gcount());
+    }
+    return crc;
+}
+
+std::string json_string(const std::string &value) {
+    std::ostringstream out;
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+// Provenance and performance of one sweep config, written as one line of the run manifest
+struct ConfigReport {
+    std::string dataset;
+    int board_dim = 0;
+    int total_games = 0;
+    int open_percent = 0;
+    int open_pos = 0;
+    int moves_before_end = 0;
+    uint64_t config_seed = 0;
+    long long playouts = 0;
+    long long accepted = 0;        // Distinct games kept
+    long long records = 0;         // Rows written, symmetric variants included
+    long long too_few_open = 0;    // Rejected by the open-position threshold
+    long long duplicates = 0;
+    long long quota_rejected = 0;  // Turned away by full strata
+    bool gave_up = false;
+    double wall_seconds = 0.0;
+    double cpu_seconds = 0.0;
+    std::vector<const StageMetrics*> stages;
+    std::vector<std::string> files;  // Every file making up the dataset, chunks included
+    bool perf_counters = false;
+    PerfTotals perf;
+    bool memory_accounting = false;
+    MemoryReport memory;
+};
+
+// Appends the manifest of a sweep to run_{seed}.jsonl: a "run" line with host, engine and settings,
+// one "config" line per generated config and a closing "sweep" line with the totals
+class RunManifest {
+public:
+    bool open(const std::string &filename, uint64_t run_seed, const std::string &settings_json) {
+        outfile.open(filename, std::ios::app);
+        if (!outfile.is_open()) {
+            std::cerr << "Failed to open run manifest: " << filename << std::endl;
+            return false;
+        }
+        seed = run_seed;
+        start = std::chrono::steady_clock::now();
+        start_cpu = process_cpu_seconds();
+        outfile << "{\"type\":\"run\",\"seed\":" << seed << ",\"started\":" << json_string(generate_timestamp(true))
+                << ",\"host\":" << json_string(host_name()) << ",\"hardware_threads\":" << std::thread::hardware_concurrency()
+                << ",\"engine\":" << json_string(ENGINE_ID) << ",\"policy\":" << json_string(POLICY_ID)
+#ifdef __VERSION__
+                << ",\"compiler\":" << json_string(__VERSION__)
+#endif
+                << ",\"settings\":" << settings_json << "}" << std::endl;
+        return true;
+    }
+
+    void add(const ConfigReport &report) {
+        if (!outfile.is_open()) {
+            return;
+        }
+        uint64_t bytes = 0;
+        std::ostringstream files;
+        for (size_t f = 0; f < report.files.size(); ++f) {
+            std::error_code error;
+            uint64_t size = std::filesystem::file_size(report.files[f], error);
+            size = error ? 0 : size;
+            bytes += size;
+            files << (f ? "," : "") << "{\"path\":" << json_string(report.files[f]) << ",\"bytes\":" << size
+                  << ",\"crc32\":\"" << std::hex << std::setw(8) << std::setfill('0') << file_crc32(report.files[f])
+                  << std::dec << std::setfill(' ') << "\"}";
+        }
+        std::ostringstream stages;
+        for (size_t s = 0; s < report.stages.size(); ++s) {
+            const StageMetrics &stage = *report.stages[s];
+            stages << (s ? "," : "") << "{\"name\":" << json_string(stage.name) << ",\"threads\":" << stage.threads
+                   << ",\"items\":" << stage.items << ",\"busy_s\":" << stage.busy_ns / 1e9
+                   << ",\"starved_s\":" << stage.starved_ns / 1e9 << ",\"blocked_s\":" << stage.blocked_ns / 1e9 << "}";
+        }
+        double seconds = std::max(report.wall_seconds, 1e-9);
+        outfile << "{\"type\":\"config\",\"dataset\":" << json_string(report.dataset)
+                << ",\"board_dim\":" << report.board_dim << ",\"total_games\":" << report.total_games
+                << ",\"open_percent\":" << report.open_percent << ",\"open_pos\":" << report.open_pos
+                << ",\"moves_before_end\":" << report.moves_before_end << ",\"run_seed\":" << seed
+                << ",\"config_seed\":" << report.config_seed << ",\"playouts\":" << report.playouts
+                << ",\"accepted\":" << report.accepted << ",\"records\":" << report.records
+                << ",\"too_few_open\":" << report.too_few_open << ",\"duplicates\":" << report.duplicates
+                << ",\"quota_rejected\":" << report.quota_rejected << ",\"gave_up\":" << (report.gave_up ? "true" : "false")
+                << ",\"wall_s\":" << report.wall_seconds << ",\"cpu_s\":" << report.cpu_seconds
+                << ",\"playouts_per_s\":" << report.playouts / seconds << ",\"records_per_s\":" << report.records / seconds
+                << ",\"bytes_per_s\":" << bytes / seconds << ",\"peak_rss_bytes\":" << peak_rss_bytes()
+                << ",\"stages\":[" << stages.str() << "],\"files\":[" << files.str() << "]";
+        if (report.perf_counters) {
+            outfile << ",\"perf\":" << perf_json(report.perf, report.playouts);
+        }
+        if (report.memory_accounting) {
+            const MemoryReport &memory = report.memory;
+            outfile << ",\"memory\":{\"peak_rss_bytes\":" << memory.peak_rss
+                    << ",\"peak_rss_per_config\":" << (memory.peak_rss_per_config ? "true" : "false")
+                    << ",\"allocations\":" << memory.allocations << ",\"allocated_bytes\":" << memory.allocated_bytes
+                    << ",\"peak_heap_bytes\":" << memory.peak_heap_bytes
+                    << ",\"unique_games_bytes\":" << memory.unique_games_bytes
+                    << ",\"game_results_bytes\":" << memory.game_results_bytes
+                    << ",\"removed_moves_bytes\":" << memory.removed_moves_bytes
+                    << ",\"compacted_keys\":" << (memory.compacted_keys ? "true" : "false")
+                    << ",\"spilled_removed_moves\":" << (memory.spilled_removed_moves ? "true" : "false") << "}";
+        }
+        outfile << "}" << std::endl;
+
+        configs++;
+        playouts += report.playouts;
+        records += report.records;
+        duplicates += report.duplicates;
+        total_bytes += bytes;
+    }
+
+    void close(int skipped_configs, const DatasetSketch &sketch) {
+        if (!outfile.is_open()) {
+            return;
+        }
+        double seconds = std::max(nanoseconds_since(start) / 1e9, 1e-9);
+        outfile << "{\"type\":\"sweep\",\"seed\":" << seed << ",\"finished\":" << json_string(generate_timestamp(true))
+                << ",\"configs\":" << configs << ",\"skipped_configs\":" << skipped_configs
+                << ",\"playouts\":" << playouts << ",\"records\":" << records << ",\"duplicates\":" << duplicates
+                << ",\"bytes\":" << total_bytes << ",\"distinct_boards_estimate\":" << std::llround(sketch.distinct_estimate())
+                << ",\"wall_s\":" << seconds
+                << ",\"cpu_s\":" << process_cpu_seconds() - start_cpu << ",\"playouts_per_s\":" << playouts / seconds
+                << ",\"records_per_s\":" << records / seconds << ",\"bytes_per_s\":" << total_bytes / seconds
+                << ",\"peak_rss_bytes\":" << peak_rss_bytes() << "}" << std::endl;
+        outfile.close();
+    }
+
+private:
+    std::ofstream outfile;
+    uint64_t seed = 0;
+
+    // Raw counts plus IPC, misses per game and branch-miss rate of every stage that ran
+    static std::string perf_json(const PerfTotals &totals, long long games) {
+        std::ostringstream out;
+        out << "{\"available\":" << (totals.available ? "true" : "false") << ",\"stages\":[";
+        bool first = true;
+        for (int s = 0; s < PERF_STAGE_COUNT; ++s) {
+            const uint64_t *counts = totals.counts[s];
+            if (totals.available == 0 || (counts[PERF_EVENT_CYCLES] == 0 && counts[PERF_EVENT_INSTRUCTIONS] == 0)) {
+                continue;
+            }
+            out << (first ? "" : ",") << "{\"name\":" << json_string(PERF_STAGE_NAMES[s]);
+            first = false;
+            for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+                if ((totals.available >> e) & 1) {
+                    out << ",\"" << PERF_EVENT_NAMES[e] << "\":" << counts[e];
+                }
+            }
+            if (counts[PERF_EVENT_CYCLES] != 0) {
+                out << ",\"ipc\":" << static_cast<double>(counts[PERF_EVENT_INSTRUCTIONS]) / counts[PERF_EVENT_CYCLES];
+            }
+            if (games > 0) {
+                out << ",\"cache_misses_per_game\":" << static_cast<double>(counts[PERF_EVENT_CACHE_MISSES]) / games;
+            }
+            if (counts[PERF_EVENT_BRANCHES] != 0) {
+                out << ",\"branch_miss_rate\":" << static_cast<double>(counts[PERF_EVENT_BRANCH_MISSES]) / counts[PERF_EVENT_BRANCHES];
+            }
+            out << "}";
+        }
+        out << "]}";
+        return out.str();
+    }
+    std::chrono::steady_clock::time_point start;
+    double start_cpu = 0.0;
+    int configs = 0;
+    long long playouts = 0;
+    long long records = 0;
+    long long duplicates = 0;
+    uint64_t total_bytes = 0;
+};
+
+// Parse "--name value" pairs following the positional arguments of a subcommand. Anything else, or
+// an option the subcommand does not know, is a usage error.
+std::map<std::string, std::string> parse_options(int argc, char *argv[], int first, const std::vector<std::string> &known) {
+    std::map<std::string, std::string> options;
+    for (int i = first; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            throw std::invalid_argument("Unexpected argument: " + arg);
+        }
+        if (std::find(known.begin(), known.end(), arg.substr(2)) == known.end()) {
+            throw std::invalid_argument("Unknown option: " + arg);
+        }
+        std::string value = "1";
+        if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+            value = argv[++i];
+        }
+        options[arg.substr(2)] = value;
+    }
+    return options;
+}
+
+// Whole-string integer and number parsing; malformed input is a usage error naming the argument
+long long parse_integer(const std::string &text, const std::string &name) {
+    size_t end = 0;
+    long long value = 0;
+    try {
+        value = std::stoll(text, &end);
+    } catch (const std::exception &) {
+        end = 0;
+    }
+    if (end == 0 || end != text.size()) {
+        throw std::invalid_argument(name + " expects an integer, got \"" + text + "\"");
+    }
+    return value;
+}
+
+double parse_number(const std::string &text, const std::string &name) {
+    size_t end = 0;
+    double value = 0.0;
+    try {
+        value = std::stod(text, &end);
+    } catch (const std::exception &) {
+        end = 0;
+    }
+    if (end == 0 || end != text.size()) {
+        throw std::invalid_argument(name + " expects a number, got \"" + text + "\"");
+    }
+    return value;
+}
+
+long long option_or(const std::map<std::string, std::string> &options, const std::string &name, long long fallback) {
+    auto it = options.find(name);
+    return it == options.end() ? fallback : parse_integer(it->second, "--" + name);
+}
+
+double option_or(const std::map<std::string, std::string> &options, const std::string &name, double fallback) {
+    auto it = options.find(name);
+    return it == options.end() ? fallback : parse_number(it->second, "--" + name);
+}
+
+std::string option_or(const std::map<std::string, std::string> &options, const std::string &name, const std::string &fallback) {
+    auto it = options.find(name);
+    return it == options.end() ? fallback : it->second;
+}
+
+// Usage lines of the tools, printed when their arguments are missing or malformed
+const std::map<std::string, std::string> TOOL_USAGE = {
+    {"corpus-index", "<dim> [--corpus-dir DIR]"},
+    {"corpus-query", "<dim> <output.csv> [--min-length N] [--max-length N] [--min-open N] [--max-open N]"
+                     " [--winner 0|1] [--starting-player 0|1] [--mbf N] [--limit N] [--format coord|string]"
+                     " [--keep-duplicates] [--corpus-dir DIR]"},
+    {"dataset-setop", "<union|intersection|difference|overlap> <a> <b> [--output FILE] [--symmetry]"
+                      " [--memory-mb N] [--temp-dir DIR]"},
+    {"dataset-convert", "<csv|manifest|directory>... [--output-dir DIR] [--merge] [--threads N]"},
+    {"sketch-merge", "<sketch|directory>... [--output FILE] [--top N]"},
+    {"catalog-build", "[--data-dir DIR] [--metadata-dir DIR] [--catalog FILE] [--threads N] [--rebuild]"},
+    {"catalog-query", "[--dim N] [--min-games N] [--max-games N] [--open N] [--mbf N] [--split NAME]"
+                      " [--format coord|string|binary] [--paths] [--catalog FILE] [--data-dir DIR]"},
+    {"bench-scaling", "[--min-dim N] [--max-dim N] [--dim-step N] [--open 10,20,30,40] [--threads 1,2,4,...]"
+                      " [--sinks null,tmpfs,disk] [--playouts N] [--tmpfs-dir DIR] [--disk-dir DIR]"
+                      " [--backend ofstream|posix|uring] [--direct-io] [--encode-threads N] [--out PREFIX]"},
+    {"engine-diff", "[--engine union-find] [--min-dim N] [--max-dim N] [--games N] [--mbf N] [--seed N]"
+                    " [--stats] [--z-limit Z] [--threads N]"},
+};
+
+void print_usage(const char *program, const std::string &command) {
+    std::cerr << "Usage: " << program << " " << command << " " << TOOL_USAGE.at(command) << std::endl;
+}
+
+// Game corpus: every playout of the sweep appended to one raw file per board dim, so datasets with
+// other thresholds, truncations or outcome mixes can be carved out later without new playouts.
+//
+// corpus_{dim}x{dim}.games (append-only):
+//   CorpusHeader, then games in the position stream layout:
+//   uint16 length, int8 starting_player, int8 winner, uint8 moves[length]
+//
+// corpus_{dim}x{dim}.index (rebuilt by corpus-index, or by corpus-query when stale):
+//   CorpusIndexHeader
+//   uint64 offsets[game_count]              byte offset of each game in the games file
+//   uint16 lengths[game_count]              plies played, open count is dim^2 - length
+//   uint32 by_length[game_count]            game ids sorted by length, ties in corpus order
+//   uint64 o_winner_bits[(game_count+63)/64]    bit g set when O won game g
+//   uint64 o_starter_bits[(game_count+63)/64]   bit g set when O started game g
+const char CORPUS_MAGIC[8] = {'H', 'E', 'X', 'C', 'O', 'R', 'P', '1'};
+const char CORPUS_INDEX_MAGIC[8] = {'H', 'E', 'X', 'C', 'I', 'D', 'X', '1'};
+const uint32_t CORPUS_FORMAT_VERSION = 1;
+
+struct CorpusHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t board_dim;
+};
+
+struct CorpusIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t board_dim;
+    uint64_t game_count;
+    uint64_t games_bytes;  // Size of the games file the index was built from
+};
+
+static_assert(sizeof(CorpusHeader) == 16, "CorpusHeader layout changed");
+static_assert(sizeof(CorpusIndexHeader) == 32, "CorpusIndexHeader layout changed");
+
+std::string corpus_filename(const std::string &directory, int dim, const std::string &extension) {
+    return directory + "corpus_" + std::to_string(dim) + "x" + std::to_string(dim) + extension;
+}
+
+// Walk the games of a corpus file, calling record(offset, game_header) for each complete one. Returns
+// the size of the file up to the end of its last complete game, or 0 if it is not a corpus file.
+uint64_t scan_corpus_records(const std::string &games_filename, CorpusHeader &header,
+                             const std::function<void(uint64_t, const uint8_t*)> &record) {
+    std::error_code error;
+    uint64_t file_size = std::filesystem::file_size(games_filename, error);
+    std::ifstream infile(games_filename, std::ios::binary);
+    if (error || !infile.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, CORPUS_MAGIC, sizeof(header.magic)) != 0) {
+        return 0;
+    }
+    uint64_t offset = sizeof(header);
+    uint8_t game_header[4];
+    while (infile.read(reinterpret_cast<char*>(game_header), sizeof(game_header))) {
+        uint16_t length;
+        std::memcpy(&length, game_header, sizeof(length));
+        // Seeking past the end does not fail, so a torn final game is caught by the size
+        if (offset + sizeof(game_header) + length > file_size || !infile.seekg(length, std::ios::cur)) {
+            break;
+        }
+        if (record) {
+            record(offset, game_header);
+        }
+        offset += sizeof(game_header) + length;
+    }
+    return offset;
+}
+
+class CorpusWriter {
+public:
+    std::ofstream outfile;
+    std::vector<uint8_t> record;
+
+    bool open(const std::string &filename, int dim) {
+        // A game torn by an interrupted run is cut off, or every game appended after it would be misframed
+        uint64_t intact = 0;
+        std::error_code error;
+        uint64_t file_size = std::filesystem::file_size(filename, error);
+        if (!error && file_size >= sizeof(CorpusHeader)) {
+            CorpusHeader header;
+            intact = scan_corpus_records(filename, header, nullptr);
+            if (intact == 0) {
+                std::cerr << "Not a corpus file: " << filename << std::endl;
+                return false;
+            }
+            if (intact < file_size) {
+                std::cout << "Dropping " << file_size - intact << " bytes of a torn game from " << filename << std::endl;
+                std::filesystem::resize_file(filename, intact, error);
+                if (error) {
+                    std::cerr << "Failed to truncate corpus file: " << filename << std::endl;
+                    return false;
+                }
+            }
+        }
+        outfile.open(filename, std::ios::binary | (intact > 0 ? std::ios::app : std::ios::trunc));
+        if (!outfile.is_open()) {
+            std::cerr << "Failed to open corpus file: " << filename << std::endl;
+            return false;
+        }
+        if (intact == 0) {
+            CorpusHeader header = {};
+            std::memcpy(header.magic, CORPUS_MAGIC, sizeof(header.magic));
+            header.version = CORPUS_FORMAT_VERSION;
+            header.board_dim = dim;
+            outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+        return true;
+    }
+
+    void append(const std::vector<int> &moves, int starting_player, int winner) {
+        encode_game_moves(moves, starting_player, winner, record);
+        outfile.write(reinterpret_cast<const char*>(record.data()), record.size());
+    }
+
+    void close() {
+        if (outfile.is_open()) {
+            outfile.close();
+        }
+    }
+};
+
+struct CorpusIndex {
+    CorpusIndexHeader header;
+    std::vector<uint64_t> offsets;
+    std::vector<uint16_t> lengths;
+    std::vector<uint32_t> by_length;
+    std::vector<uint64_t> o_winner_bits;
+    std::vector<uint64_t> o_starter_bits;
+
+    bool o_won(uint64_t game) const { return (o_winner_bits[game >> 6] >> (game & 63)) & 1; }
+    bool o_started(uint64_t game) const { return (o_starter_bits[game >> 6] >> (game & 63)) & 1; }
+};
+
+// Scan the games file once and write its index
+bool build_corpus_index(const std::string &games_filename, const std::string &index_filename, CorpusIndex &index) {
+    index = CorpusIndex();
+    CorpusHeader header;
+    std::vector<int8_t> winners;
+    std::vector<int8_t> starters;
+    uint64_t intact = scan_corpus_records(games_filename, header, [&](uint64_t offset, const uint8_t *game_header) {
+        uint16_t length;
+        std::memcpy(&length, game_header, sizeof(length));
+        index.offsets.push_back(offset);
+        index.lengths.push_back(length);
+        starters.push_back(static_cast<int8_t>(game_header[2]));
+        winners.push_back(static_cast<int8_t>(game_header[3]));
+    });
+    if (intact == 0) {
+        std::cerr << "Not a corpus file: " << games_filename << std::endl;
+        return false;
+    }
+
+    uint64_t n = index.offsets.size();
+    index.by_length.resize(n);
+    for (uint64_t g = 0; g < n; ++g) {
+        index.by_length[g] = g;
+    }
+    std::stable_sort(index.by_length.begin(), index.by_length.end(),
+                     [&index](uint32_t a, uint32_t b) { return index.lengths[a] < index.lengths[b]; });
+    index.o_winner_bits.assign((n + 63) / 64, 0);
+    index.o_starter_bits.assign((n + 63) / 64, 0);
+    for (uint64_t g = 0; g < n; ++g) {
+        index.o_winner_bits[g >> 6] |= static_cast<uint64_t>(winners[g] == 1) << (g & 63);
+        index.o_starter_bits[g >> 6] |= static_cast<uint64_t>(starters[g] == 1) << (g & 63);
+    }
+
+    std::memcpy(index.header.magic, CORPUS_INDEX_MAGIC, sizeof(index.header.magic));
+    index.header.version = CORPUS_FORMAT_VERSION;
+    index.header.board_dim = header.board_dim;
+    index.header.game_count = n;
+    // A torn final game is left out of the index, which still matches the file as it is
+    std::error_code error;
+    index.header.games_bytes = std::filesystem::file_size(games_filename, error);
+
+    std::ofstream outfile(index_filename, std::ios::binary);
+    if (!outfile.is_open()) {
+        std::cerr << "Failed to open corpus index file: " << index_filename << std::endl;
+        return false;
+    }
+    outfile.write(reinterpret_cast<const char*>(&index.header), sizeof(index.header));
+    outfile.write(reinterpret_cast<const char*>(index.offsets.data()), n * sizeof(uint64_t));
+    outfile.write(reinterpret_cast<const char*>(index.lengths.data()), n * sizeof(uint16_t));
+    outfile.write(reinterpret_cast<const char*>(index.by_length.data()), n * sizeof(uint32_t));
+    outfile.write(reinterpret_cast<const char*>(index.o_winner_bits.data()), index.o_winner_bits.size() * sizeof(uint64_t));
+    outfile.write(reinterpret_cast<const char*>(index.o_starter_bits.data()), index.o_starter_bits.size() * sizeof(uint64_t));
+    outfile.close();
+    return true;
+}
+
+// Load the index, rebuilding it if it is missing or older than the games file
+bool load_corpus_index(const std::string &games_filename, const std::string &index_filename, CorpusIndex &index) {
+    if (!std::filesystem::exists(games_filename)) {
+        std::cerr << "Corpus file not found: " << games_filename << std::endl;
+        return false;
+    }
+    uint64_t games_bytes = std::filesystem::file_size(games_filename);
+
+    std::ifstream infile(index_filename, std::ios::binary);
+    if (infile.read(reinterpret_cast<char*>(&index.header), sizeof(index.header)) &&
+        std::memcmp(index.header.magic, CORPUS_INDEX_MAGIC, sizeof(index.header.magic)) == 0 &&
+        index.header.games_bytes == games_bytes) {
+        uint64_t n = index.header.game_count;
+        index.offsets.resize(n);
+        index.lengths.resize(n);
+        index.by_length.resize(n);
+        index.o_winner_bits.resize((n + 63) / 64);
+        index.o_starter_bits.resize((n + 63) / 64);
+        infile.read(reinterpret_cast<char*>(index.offsets.data()), n * sizeof(uint64_t));
+        infile.read(reinterpret_cast<char*>(index.lengths.data()), n * sizeof(uint16_t));
+        infile.read(reinterpret_cast<char*>(index.by_length.data()), n * sizeof(uint32_t));
+        infile.read(reinterpret_cast<char*>(index.o_winner_bits.data()), index.o_winner_bits.size() * sizeof(uint64_t));
+        infile.read(reinterpret_cast<char*>(index.o_starter_bits.data()), index.o_starter_bits.size() * sizeof(uint64_t));
+        if (infile) {
+            return true;
+        }
+    }
+    infile.close();
+
+    std::cout << "Rebuilding corpus index: " << index_filename << std::endl;
+    return build_corpus_index(games_filename, index_filename, index);
+}
+
+// corpus-index <dim> [--corpus-dir DIR]
+int run_corpus_index(int argc, char *argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0], "corpus-index");
+        return 1;
+    }
+    int dim = parse_integer(argv[2], "<dim>");
+    auto options = parse_options(argc, argv, 3, {"corpus-dir"});
+    std::string directory = option_or(options, "corpus-dir", std::string("F:\\TsetlinModels\\corpus\\"));
+
+    CorpusIndex index;
+    if (!build_corpus_index(corpus_filename(directory, dim, ".games"), corpus_filename(directory, dim, ".index"), index)) {
+        return 1;
+    }
+    std::cout << "Indexed " << index.header.game_count << " games" << std::endl;
+    return 0;
+}
+
+// corpus-query <dim> <output.csv> [--min-length N] [--max-length N] [--min-open N] [--max-open N]
+//              [--winner 0|1] [--starting-player 0|1] [--mbf N] [--limit N] [--format coord|string]
+//              [--keep-duplicates] [--corpus-dir DIR]
+int run_corpus_query(int argc, char *argv[]) {
+    if (argc < 4) {
+        print_usage(argv[0], "corpus-query");
+        return 1;
+    }
+    int dim = parse_integer(argv[2], "<dim>");
+    std::string output_filename = argv[3];
+    auto options = parse_options(argc, argv, 4, {"corpus-dir", "format", "mbf", "limit", "winner", "starting-player",
+                                                 "keep-duplicates", "min-length", "max-length", "min-open", "max-open"});
+    std::string directory = option_or(options, "corpus-dir", std::string("F:\\TsetlinModels\\corpus\\"));
+    std::string format = option_or(options, "format", std::string("coord"));
+    int moves_before_end = option_or(options, "mbf", 0LL);
+    long long limit = option_or(options, "limit", -1LL);
+    int winner_filter = option_or(options, "winner", -1LL);
+    int starter_filter = option_or(options, "starting-player", -1LL);
+    bool keep_duplicates = options.count("keep-duplicates") != 0;
+
+    // Open counts are dim^2 - length, so both filters narrow the same length range
+    int min_length = option_or(options, "min-length", 0LL);
+    int max_length = option_or(options, "max-length", static_cast<long long>(dim * dim));
+    min_length = std::max<int>(min_length, dim * dim - option_or(options, "max-open", static_cast<long long>(dim * dim)));
+    max_length = std::min<int>(max_length, dim * dim - option_or(options, "min-open", 0LL));
+    // A truncated game must still have its moves_before_end moves to remove
+    min_length = std::max(min_length, moves_before_end);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::string games_filename = corpus_filename(directory, dim, ".games");
+    CorpusIndex index;
+    if (!load_corpus_index(games_filename, corpus_filename(directory, dim, ".index"), index)) {
+        return 1;
+    }
+
+    // Length range from the sorted column, then the outcome bitmaps
+    auto first = std::lower_bound(index.by_length.begin(), index.by_length.end(), min_length,
+                                  [&index](uint32_t g, int length) { return index.lengths[g] < length; });
+    auto last = std::upper_bound(index.by_length.begin(), index.by_length.end(), max_length,
+                                 [&index](int length, uint32_t g) { return length < index.lengths[g]; });
+    std::vector<uint32_t> selected;
+    for (auto it = first; it < last; ++it) {
+        uint32_t g = *it;
+        if ((winner_filter >= 0 && index.o_won(g) != (winner_filter == 1)) ||
+            (starter_filter >= 0 && index.o_started(g) != (starter_filter == 1))) {
+            continue;
+        }
+        selected.push_back(g);
+    }
+    // Corpus order keeps the carve-out deterministic and reads the games file front to back
+    std::sort(selected.begin(), selected.end());
+
+    std::vector<std::unique_ptr<FileWriter>> writers;
+    writers.push_back(open_csv_writer(output_filename, "ofstream", false, 0, format, dim, false, false));
+    if (!writers[0]) {
+        return 1;
+    }
+
+    std::ifstream games(games_filename, std::ios::binary);
+    HexGame hg(dim);
+    std::unordered_set<std::string> unique_games;
+    std::vector<GameRecord> results;
+    std::vector<uint8_t> record;
+    long long written = 0;
+    for (uint32_t g : selected) {
+        if (limit >= 0 && written >= limit) {
+            break;
+        }
+        record.resize(4 + index.lengths[g]);
+        games.seekg(index.offsets[g]);
+        if (!games.read(reinterpret_cast<char*>(record.data()), record.size())) {
+            std::cerr << "Failed to read game " << g << " from " << games_filename << ", rerun corpus-index" << std::endl;
+            return 1;
+        }
+        int starting_player = static_cast<int8_t>(record[2]);
+        int winner = static_cast<int8_t>(record[3]);
+
+        PackedBoard board = {};
+        int kept = index.lengths[g] - moves_before_end;
+        for (int k = 0; k < kept; ++k) {
+            int cell = record[4 + k];
+            uint64_t *stones = ((starting_player ^ (k & 1)) == 0) ? board.x : board.o;
+            stones[cell >> 6] |= 1ULL << (cell & 63);
+        }
+        if (!keep_duplicates && !unique_games.insert(board.key()).second) {
+            continue;
+        }
+        results.push_back({board, starting_player, winner, SYMMETRY_IDENTITY, 0, g});
+        written++;
+    }
+    write_results_to_csv(writers, format, hg, results, false, false);
+    writers[0]->close();
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "Wrote " << written << " of " << selected.size() << " matching games (" << index.header.game_count
+              << " in corpus) to " << output_filename << " in " << elapsed.count() << " s" << std::endl;
+    return 0;
+}
+
+// Layout of a dataset file as detected by read_dataset
+struct DatasetInfo {
+    int board_dim = 0;
+    std::string format;  // "coord", "string", "graph" or "binary"
+};
+
+// Stream the boards of a dataset file in file order. Reads coord and string CSVs (trailing optional
+// columns are ignored, as are the stray starting_player,winner lines of old string files), the
+// graph export, .hxb binary datasets and chunk manifests. The callback returns false to stop early.
+bool read_dataset(const std::string &filename, DatasetInfo &info, const std::function<bool(const GameRecord&)> &callback) {
+    std::ifstream infile(filename, std::ios::binary);
+    if (!infile.is_open()) {
+        std::cerr << "Failed to open the file: " << filename << std::endl;
+        return false;
+    }
+
+    char magic[8] = {};
+    infile.read(magic, sizeof(magic));
+    infile.seekg(0);
+    if (std::memcmp(magic, GRAPH_SAMPLES_MAGIC, sizeof(magic)) == 0) {
+        GraphSamplesHeader header;
+        infile.read(reinterpret_cast<char*>(&header), sizeof(header));
+        info.board_dim = header.board_dim;
+        info.format = "graph";
+        uint32_t nodes = header.node_count;
+        size_t symbols_offset = (header.flags & GRAPH_FLAG_GROUP_IDS) ? nodes * sizeof(uint16_t) : 0;
+        std::vector<uint8_t> record(header.record_size);
+        for (uint64_t r = 0; r < header.record_count; ++r) {
+            if (!infile.read(reinterpret_cast<char*>(record.data()), record.size())) {
+                break;
+            }
+            const uint8_t *symbols = record.data() + symbols_offset;
+            GameRecord game = {};
+            for (uint32_t cell = 0; cell < nodes; ++cell) {
+                game.board.x[cell >> 6] |= static_cast<uint64_t>((symbols[cell] & GRAPH_SYMBOL_X) != 0) << (cell & 63);
+                game.board.o[cell >> 6] |= static_cast<uint64_t>((symbols[cell] & GRAPH_SYMBOL_O) != 0) << (cell & 63);
+            }
+            game.starting_player = static_cast<int8_t>(symbols[nodes]);
+            game.winner = static_cast<int8_t>(symbols[nodes + 1]);
+            game.game_index = r;
+            if (!callback(game)) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    if (std::memcmp(magic, BINARY_DATASET_MAGIC, sizeof(magic)) == 0) {
+        BinaryDatasetHeader header;
+        infile.read(reinterpret_cast<char*>(&header), sizeof(header));
+        info.board_dim = header.board_dim;
+        info.format = "binary";
+        infile.seekg(header.header_size);
+        std::vector<uint8_t> record(header.record_size);
+        for (uint64_t r = 0; r < header.record_count; ++r) {
+            if (!infile.read(reinterpret_cast<char*>(record.data()), record.size())) {
+                break;
+            }
+            GameRecord game = {};
+            decode_binary_record(record.data(), header.board_dim, game);
+            game.game_index = r;
+            if (!callback(game)) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    std::string line;
+    if (!std::getline(infile, line)) {
+        return false;
+    }
+
+    // Chunked dataset: read the chunks listed in the manifest, numbering rows across them
+    if (line.rfind("chunk,filename,", 0) == 0) {
+        std::string directory = filename.substr(0, filename.find_last_of("\\/") + 1);
+        uint64_t first_record = 0;
+        bool keep_going = true;
+        while (keep_going && std::getline(infile, line)) {
+            size_t name_start = line.find(',') + 1;
+            std::string chunk_filename = directory + line.substr(name_start, line.find(',', name_start) - name_start);
+            uint64_t rows = 0;
+            bool ok = read_dataset(chunk_filename, info, [&](const GameRecord &chunk_game) {
+                GameRecord game = chunk_game;
+                game.game_index = first_record + rows++;
+                keep_going = callback(game);
+                return keep_going;
+            });
+            if (!ok) {
+                return false;
+            }
+            first_record += rows;
+        }
+        return true;
+    }
+
+    info.format = line.rfind("board,", 0) == 0 ? "string" : "coord";
+    if (info.format == "coord") {
+        int cells = std::count(line.begin(), line.begin() + line.find("starting_player"), ',');
+        while ((info.board_dim + 1) * (info.board_dim + 1) <= cells) {
+            info.board_dim++;
+        }
+    }
+
+    uint64_t row = 0;
+    while (std::getline(infile, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        GameRecord game = {};
+        game.game_index = row++;
+        size_t pos = 0;
+        if (info.format == "string") {
+            size_t comma = line.find(',');
+            if (comma == std::string::npos) {
+                continue;
+            }
+            if (info.board_dim == 0) {
+                while ((info.board_dim + 1) * (info.board_dim + 1) <= static_cast<int>(comma)) {
+                    info.board_dim++;
+                }
+            }
+            if (static_cast<int>(comma) != info.board_dim * info.board_dim) {
+                continue;
+            }
+            for (size_t cell = 0; cell < comma; ++cell) {
+                game.board.x[cell >> 6] |= static_cast<uint64_t>(line[cell] == 'X') << (cell & 63);
+                game.board.o[cell >> 6] |= static_cast<uint64_t>(line[cell] == 'O') << (cell & 63);
+            }
+            pos = comma + 1;
+        } else {
+            int cells = info.board_dim * info.board_dim;
+            for (int cell = 0; cell < cells && pos < line.size(); ++cell) {
+                if (line[pos] == '-') {
+                    game.board.o[cell >> 6] |= 1ULL << (cell & 63);
+                    pos++;
+                } else if (line[pos] == '1') {
+                    game.board.x[cell >> 6] |= 1ULL << (cell & 63);
+                }
+                pos = line.find(',', pos) + 1;
+            }
+        }
+
+        // starting_player,winner follow the board; old string files only had the winner
+        std::vector<int> values;
+        while (pos > 0 && pos <= line.size() && values.size() < 2) {
+            values.push_back(std::atoi(line.c_str() + pos));
+            size_t comma = line.find(',', pos);
+            pos = comma == std::string::npos ? 0 : comma + 1;
+        }
+        game.starting_player = values.size() == 2 ? values[0] : -1;
+        game.winner = values.empty() ? -1 : values.back();
+        if (!callback(game)) {
+            break;
+        }
+    }
+    return true;
+}
+
+// Sorted, de-duplicated 64-bit hashes of arbitrarily many boards. Hashes are collected up to a memory
+// budget, then sorted runs are spilled to temporary files and merged back on read.
+class ExternalHashSet {
+public:
+    ExternalHashSet(const std::string &temp_prefix, size_t max_in_memory)
+        : prefix(temp_prefix), max_buffer(std::max<size_t>(max_in_memory, 1024)) {}
+
+    ~ExternalHashSet() {
+        for (const auto& run : runs) {
+            std::remove(run.c_str());
+        }
+    }
+
+    void add(uint64_t hash) {
+        buffer.push_back(hash);
+        if (buffer.size() >= max_buffer) {
+            spill();
+        }
+    }
+
+    // Sort the remaining hashes; call once before reading
+    void finish() {
+        sort_unique(buffer);
+        if (!runs.empty() && !buffer.empty()) {
+            spill();
+        }
+        for (const auto& run : runs) {
+            readers.emplace_back(new std::ifstream(run, std::ios::binary));
+            heads.emplace_back();
+            advance(readers.size() - 1);
+        }
+        buffer_pos = 0;
+    }
+
+    // Next hash in ascending order without duplicates; false at the end
+    bool next(uint64_t &hash) {
+        if (runs.empty()) {
+            if (buffer_pos >= buffer.size()) {
+                return false;
+            }
+            hash = buffer[buffer_pos++];
+            return true;
+        }
+        // The number of runs is small, so a linear scan for the minimum is enough
+        while (true) {
+            int best = -1;
+            for (size_t r = 0; r < heads.size(); ++r) {
+                if (heads[r].second && (best < 0 || heads[r].first < heads[best].first)) {
+                    best = r;
+                }
+            }
+            if (best < 0) {
+                return false;
+            }
+            hash = heads[best].first;
+            advance(best);
+            if (!has_last || hash != last) {
+                has_last = true;
+                last = hash;
+                return true;
+            }
+        }
+    }
+
+private:
+    std::string prefix;
+    size_t max_buffer;
+    std::vector<uint64_t> buffer;
+    size_t buffer_pos = 0;
+    std::vector<std::string> runs;
+    std::vector<std::unique_ptr<std::ifstream>> readers;
+    std::vector<std::pair<uint64_t, bool>> heads;
+    uint64_t last = 0;
+    bool has_last = false;
+
+    static void sort_unique(std::vector<uint64_t> &values) {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+    }
+
+    void spill() {
+        sort_unique(buffer);
+        std::string run = prefix + ".run" + std::to_string(runs.size());
+        std::ofstream outfile(run, std::ios::binary);
+        outfile.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(uint64_t));
+        runs.push_back(run);
+        buffer.clear();
+    }
+
+    void advance(size_t r) {
+        heads[r].second = static_cast<bool>(readers[r]->read(reinterpret_cast<char*>(&heads[r].first), sizeof(uint64_t)));
+    }
+};
+
+// Records sorted by board hash, ties kept in insertion order. Like ExternalHashSet, entries are
+// buffered up to a memory budget and spilled as sorted runs that are merged back on read.
+class ExternalRecordSort {
+public:
+    ExternalRecordSort(const std::string &temp_prefix, size_t max_in_memory)
+        : prefix(temp_prefix), max_buffer(std::max<size_t>(max_in_memory, 1024)) {}
+
+    ~ExternalRecordSort() {
+        readers.clear();
+        for (const auto& run : runs) {
+            std::remove(run.c_str());
+        }
+    }
+
+    void add(uint64_t hash, const GameRecord &game) {
+        buffer.push_back({hash, count++, game});
+        if (buffer.size() >= max_buffer) {
+            spill();
+        }
+    }
+
+    // Sort the remaining entries; call once before reading
+    void finish() {
+        std::sort(buffer.begin(), buffer.end(), entry_less);
+        if (!runs.empty() && !buffer.empty()) {
+            spill();
+        }
+        for (const auto& run : runs) {
+            readers.emplace_back(new std::ifstream(run, std::ios::binary));
+            heads.emplace_back();
+            advance(readers.size() - 1);
+        }
+        buffer_pos = 0;
+    }
+
+    // Next record in (hash, insertion) order; false at the end
+    bool next(uint64_t &hash, GameRecord &game) {
+        const Entry *entry = nullptr;
+        if (runs.empty()) {
+            if (buffer_pos < buffer.size()) {
+                entry = &buffer[buffer_pos++];
+            }
+        } else {
+            int best = -1;
+            for (size_t r = 0; r < heads.size(); ++r) {
+                if (heads[r].second && (best < 0 || entry_less(heads[r].first, heads[best].first))) {
+                    best = r;
+                }
+            }
+            if (best >= 0) {
+                current = heads[best].first;
+                entry = &current;
+                advance(best);
+            }
+        }
+        if (!entry) {
+            return false;
+        }
+        hash = entry->hash;
+        game = entry->game;
+        return true;
+    }
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint64_t sequence;
+        GameRecord game;
+    };
+
+    std::string prefix;
+    size_t max_buffer;
+    uint64_t count = 0;
+    std::vector<Entry> buffer;
+    size_t buffer_pos = 0;
+    std::vector<std::string> runs;
+    std::vector<std::unique_ptr<std::ifstream>> readers;
+    std::vector<std::pair<Entry, bool>> heads;
+    Entry current;
+
+    static bool entry_less(const Entry &a, const Entry &b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.sequence < b.sequence;
+    }
+
+    void spill() {
+        std::sort(buffer.begin(), buffer.end(), entry_less);
+        std::string run = prefix + ".run" + std::to_string(runs.size());
+        std::ofstream outfile(run, std::ios::binary);
+        outfile.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(Entry));
+        runs.push_back(run);
+        buffer.clear();
+    }
+
+    void advance(size_t r) {
+        heads[r].second = static_cast<bool>(readers[r]->read(reinterpret_cast<char*>(&heads[r].first), sizeof(Entry)));
+    }
+};
+
+// Prefix for temporary files that does not collide with other processes sharing the directory
+std::string unique_temp_prefix(const std::string &temp_dir, const std::string &name) {
+    static std::atomic<int> counter{0};
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    long pid = getpid();
+#endif
+    std::string unique = name + "_" + std::to_string(pid) + "_" + std::to_string(counter++);
+    return (std::filesystem::path(temp_dir) / unique).string();
+}
+
+// Hash used to compare boards across datasets, optionally reduced modulo symmetry
+uint64_t dataset_board_hash(const PackedBoard &board, const BoardSymmetry *symmetry) {
+    return symmetry ? symmetry->canonical(board).hash() : board.hash();
+}
+
+// dataset-setop <union|intersection|difference|overlap> <a> <b> [--output FILE] [--symmetry]
+//               [--memory-mb N] [--temp-dir DIR]
+int run_dataset_setop(int argc, char *argv[]) {
+    if (argc < 5) {
+        print_usage(argv[0], "dataset-setop");
+        return 1;
+    }
+    std::string operation = argv[2];
+    std::string filenames[2] = {argv[3], argv[4]};
+    auto options = parse_options(argc, argv, 5, {"output", "symmetry", "memory-mb", "temp-dir"});
+    std::string output_filename = option_or(options, "output", std::string());
+    bool modulo_symmetry = options.count("symmetry") != 0;
+    size_t memory_bytes = option_or(options, "memory-mb", 1024LL) * 1024 * 1024;
+    size_t max_hashes = memory_bytes / sizeof(uint64_t) / 2;
+    std::string temp_dir = option_or(options, "temp-dir", std::filesystem::temp_directory_path().string());
+    if (operation != "union" && operation != "intersection" && operation != "difference" && operation != "overlap") {
+        std::cerr << "Unknown set operation: " << operation << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    DatasetInfo infos[2];
+    std::unique_ptr<BoardSymmetry> symmetry;
+    std::unique_ptr<ExternalHashSet> sets[2];
+    uint64_t rows[2] = {0, 0};
+    std::string prefix = unique_temp_prefix(temp_dir, "setop");
+    for (int f = 0; f < 2; ++f) {
+        sets[f].reset(new ExternalHashSet(prefix + "_" + std::to_string(f), max_hashes));
+        bool ok = read_dataset(filenames[f], infos[f], [&](const GameRecord &game) {
+            if (modulo_symmetry && !symmetry) {
+                symmetry.reset(new BoardSymmetry(infos[f].board_dim));
+            }
+            sets[f]->add(dataset_board_hash(game.board, symmetry.get()));
+            rows[f]++;
+            return true;
+        });
+        if (!ok) {
+            return 1;
+        }
+        sets[f]->finish();
+    }
+    if (infos[0].board_dim != infos[1].board_dim) {
+        std::cerr << "Board dimensions differ: " << infos[0].board_dim << " vs " << infos[1].board_dim << std::endl;
+        return 1;
+    }
+
+    // Merge the two sorted streams, spilling the hashes of the result if it is to be written.
+    // They come out sorted, so the file is a single run.
+    bool keep_result = !output_filename.empty() && operation != "overlap";
+    std::string result_filename = prefix + ".result";
+    std::ofstream result;
+    if (keep_result) {
+        result.open(result_filename, std::ios::binary);
+        if (!result) {
+            std::cerr << "Could not create " << result_filename << std::endl;
+            return 1;
+        }
+    }
+    auto keep = [&](uint64_t hash) {
+        result.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    };
+    uint64_t only_a = 0, only_b = 0, both = 0;
+    uint64_t a, b;
+    bool has_a = sets[0]->next(a);
+    bool has_b = sets[1]->next(b);
+    while (has_a || has_b) {
+        if (has_a && (!has_b || a < b)) {
+            only_a++;
+            if (keep_result && operation != "intersection") keep(a);
+            has_a = sets[0]->next(a);
+        } else if (has_b && (!has_a || b < a)) {
+            only_b++;
+            if (keep_result && operation == "union") keep(b);
+            has_b = sets[1]->next(b);
+        } else {
+            both++;
+            if (keep_result && operation != "difference") keep(a);
+            has_a = sets[0]->next(a);
+            has_b = sets[1]->next(b);
+        }
+    }
+
+    std::cout << "A: " << filenames[0] << " - " << rows[0] << " rows, " << only_a + both << " distinct" << std::endl;
+    std::cout << "B: " << filenames[1] << " - " << rows[1] << " rows, " << only_b + both << " distinct" << std::endl;
+    std::cout << "Intersection: " << both << " | Union: " << only_a + only_b + both
+              << " | A only: " << only_a << " | B only: " << only_b << std::endl;
+    if (only_a + both > 0 && only_b + both > 0) {
+        std::cout << std::fixed << std::setprecision(2)
+                  << "Shared: " << 100.0 * both / (only_a + both) << "% of A, " << 100.0 * both / (only_b + both)
+                  << "% of B, Jaccard " << static_cast<double>(both) / (only_a + only_b + both) << std::defaultfloat << std::endl;
+    }
+
+    sets[0].reset();
+    sets[1].reset();
+
+    if (keep_result) {
+        // Second pass sorts the candidate records by hash and merges them against the result run,
+        // writing the first record seen for every hash in the result
+        result.close();
+        std::string format = infos[0].format == "graph" ? "coord" : infos[0].format;
+        std::vector<std::unique_ptr<FileWriter>> writers;
+        writers.push_back(open_csv_writer(output_filename, "ofstream", false, 0, format, infos[0].board_dim, false, false));
+        if (!writers[0]) {
+            std::remove(result_filename.c_str());
+            return 1;
+        }
+
+        ExternalRecordSort candidates(prefix + "_records", memory_bytes / (2 * sizeof(uint64_t) + sizeof(GameRecord)));
+        int sources = operation == "union" ? 2 : 1;
+        for (int f = 0; f < sources; ++f) {
+            DatasetInfo info;
+            read_dataset(filenames[f], info, [&](const GameRecord &game) {
+                candidates.add(dataset_board_hash(game.board, symmetry.get()), game);
+                return true;
+            });
+        }
+        candidates.finish();
+
+        HexGame hg(infos[0].board_dim);
+        std::ifstream result_run(result_filename, std::ios::binary);
+        std::vector<GameRecord> results;
+        uint64_t written = 0, wanted = 0, hash, last = 0;
+        bool has_wanted = static_cast<bool>(result_run.read(reinterpret_cast<char*>(&wanted), sizeof(wanted)));
+        bool has_last = false;
+        GameRecord game;
+        while (has_wanted && candidates.next(hash, game)) {
+            while (has_wanted && wanted < hash) {
+                has_wanted = static_cast<bool>(result_run.read(reinterpret_cast<char*>(&wanted), sizeof(wanted)));
+            }
+            if (!has_wanted || wanted != hash || (has_last && last == hash)) {
+                continue;
+            }
+            has_last = true;
+            last = hash;
+            results.push_back(game);
+            results.back().split = 0;
+            written++;
+            if (results.size() >= 65536) {
+                write_results_to_csv(writers, format, hg, results, false, false);
+                results.clear();
+            }
+        }
+        result_run.close();
+        std::remove(result_filename.c_str());
+        write_results_to_csv(writers, format, hg, results, false, false);
+        writers[0]->close();
+        std::cout << "Wrote " << written << " games to " << output_filename << std::endl;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "Done in " << elapsed.count() << " s" << std::endl;
+    return 0;
+}
+
+// Copy the reader's bit-packed batch into GameRecords
+void unpack_reader_batch(const uint8_t *boards, const int8_t *starting_players, const int8_t *winners, int64_t count,
+                         int board_dim, std::vector<GameRecord> &games) {
+    uint32_t plane = binary_plane_bytes(board_dim);
+    games.resize(count);
+    for (int64_t r = 0; r < count; ++r) {
+        GameRecord &game = games[r];
+        game = {};
+        std::memcpy(game.board.x, boards + r * 2 * plane, plane);
+        std::memcpy(game.board.o, boards + r * 2 * plane + plane, plane);
+        game.starting_player = starting_players[r];
+        game.winner = winners[r];
+    }
+}
+
+// Write encoded records as a .hxb file, with metadata recomputed from them
+bool write_converted_dataset(const std::string &filename, const std::string &metadata_filename, int board_dim,
+                             const std::vector<uint8_t> &records) {
+    uint32_t record_size = binary_record_size(board_dim);
+    uint64_t count = records.size() / record_size;
+    FixedRecordFile file;
+    if (!file.open(filename, board_dim, 0, count)) {
+        return false;
+    }
+    std::unordered_set<std::string> unique_games;
+    DatasetSketch sketch;
+    int wins[2] = {0, 0};
+    GameRecord game = {};
+    for (uint64_t r = 0; r < count; ++r) {
+        std::memcpy(file.slot(r), records.data() + r * record_size, record_size);
+        decode_binary_record(records.data() + r * record_size, board_dim, game);
+        unique_games.insert(game.board.key());
+        sketch.add(game, board_dim);
+        if (game.winner == 0 || game.winner == 1) {
+            wins[game.winner]++;
+        }
+    }
+    if (!file.commit(count)) {
+        return false;
+    }
+    // Truncation and seed of legacy files are unknown
+    save_metadata_with_removed_moves(metadata_filename, filename, board_dim, count, unique_games.size(), wins[0], wins[1],
+                                     "binary", {}, -1, 0);
+    return sketch.save(sketch_filename(metadata_filename));
+}
+
+// dataset-convert <csv|manifest|directory>... [--output-dir DIR] [--merge] [--threads N]
+//
+// Convert coord and string CSVs, old string files and chunk manifests into .hxb datasets. Inputs
+// are parsed in parallel through the reader library: each becomes {output-dir}/{name}.hxb, or with
+// --merge all inputs of a board dim are concatenated into merged_{dim}x{dim}.hxb in argument order.
+// Directories contribute their *.csv files; chunk files are converted through their manifest.
+int run_dataset_convert(int argc, char *argv[]) {
+    std::vector<std::string> inputs;
+    int first_option = 2;
+    for (; first_option < argc && std::string(argv[first_option]).rfind("--", 0) != 0; ++first_option) {
+        std::filesystem::path path(argv[first_option]);
+        if (!std::filesystem::is_directory(path)) {
+            inputs.push_back(path.string());
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            std::string name = entry.path().filename().string();
+            if (entry.is_regular_file() && entry.path().extension() == ".csv" && name.find(".part") == std::string::npos &&
+                name.rfind("metadata_", 0) != 0) {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        inputs.insert(inputs.end(), found.begin(), found.end());
+    }
+    if (inputs.empty()) {
+        print_usage(argv[0], "dataset-convert");
+        return 1;
+    }
+    auto options = parse_options(argc, argv, first_option, {"output-dir", "merge", "threads"});
+    std::filesystem::path output_dir = option_or(options, "output-dir", std::string("."));
+    bool merge = options.count("merge") != 0;
+    int threads = std::max<long long>(1, option_or(options, "threads", static_cast<long long>(std::thread::hardware_concurrency())));
+    std::filesystem::create_directories(output_dir);
+
+    // Output names follow the inputs, minus .csv or .manifest.csv; a manifest's size is its chunks'
+    std::vector<std::string> output_names(inputs.size());
+    std::vector<uint64_t> input_sizes(inputs.size(), 0);
+    std::map<std::string, size_t> first_with_name;
+    const std::string manifest_suffix = ".manifest.csv";
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        std::string name = std::filesystem::path(inputs[i]).filename().string();
+        std::error_code error;
+        if (name.size() > manifest_suffix.size() &&
+            name.compare(name.size() - manifest_suffix.size(), manifest_suffix.size(), manifest_suffix) == 0) {
+            name.erase(name.size() - manifest_suffix.size());
+            std::ifstream manifest(inputs[i]);
+            std::string line;
+            std::getline(manifest, line);
+            while (std::getline(manifest, line)) {
+                size_t name_start = line.find(',') + 1;
+                std::string chunk = line.substr(name_start, line.find(',', name_start) - name_start);
+                uint64_t size = std::filesystem::file_size(std::filesystem::path(inputs[i]).parent_path() / chunk, error);
+                input_sizes[i] += error ? 0 : size;
+            }
+        } else {
+            name.erase(name.size() - std::min<size_t>(name.size(), 4));
+            uint64_t size = std::filesystem::file_size(inputs[i], error);
+            input_sizes[i] = error ? 0 : size;
+        }
+        output_names[i] = name;
+        if (!merge && !first_with_name.emplace(name, i).second) {
+            std::cerr << inputs[first_with_name[name]] << " and " << inputs[i] << " would both be converted to "
+                      << name << ".hxb" << std::endl;
+            return 1;
+        }
+    }
+
+    // Few large files are parsed with several threads each, many small ones one per thread
+    int file_threads = std::min<int>(threads, inputs.size());
+    int parse_threads = std::max(1, threads / file_threads);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<int> board_dims(inputs.size(), 0);
+    std::vector<std::vector<uint8_t>> merged_records(merge ? inputs.size() : 0);  // Per input, written per dim at the end
+    std::atomic<size_t> next_input(0);
+    std::atomic<uint64_t> total_records(0), input_bytes(0);
+    std::atomic<int> failures(0);
+    std::mutex print_mutex;
+
+    auto convert = [&]() {
+        std::vector<uint8_t> boards;
+        std::vector<int8_t> starting_players, winners;
+        std::vector<GameRecord> games;
+        for (size_t i = next_input++; i < inputs.size(); i = next_input++) {
+            hex_reader_options reader_options;
+            hex_reader_default_options(&reader_options);
+            reader_options.layout = HEX_LAYOUT_BITPACKED;
+            reader_options.batch_size = 4096;
+            reader_options.prefetch_threads = 0;
+            reader_options.parse_threads = parse_threads;
+            hex_reader *reader = hex_reader_open(inputs[i].c_str(), &reader_options);
+            if (reader == nullptr) {
+                std::lock_guard<std::mutex> lock(print_mutex);
+                std::cerr << "Skipping " << inputs[i] << ": " << hex_reader_last_error() << std::endl;
+                failures++;
+                continue;
+            }
+            int board_dim = hex_reader_board_dim(reader);
+            uint32_t record_size = binary_record_size(board_dim);
+            std::vector<uint8_t> records(hex_reader_record_count(reader) * record_size);
+            boards.resize(reader_options.batch_size * hex_reader_board_bytes(reader));
+            starting_players.resize(reader_options.batch_size);
+            winners.resize(reader_options.batch_size);
+            hex_batch batch = {boards.data(), starting_players.data(), winners.data()};
+            uint64_t written = 0;
+            for (int64_t count; (count = hex_reader_next_batch(reader, &batch)) > 0;) {
+                unpack_reader_batch(boards.data(), starting_players.data(), winners.data(), count, board_dim, games);
+                for (const GameRecord &game : games) {
+                    encode_binary_record(game, board_dim, records.data() + written++ * record_size);
+                }
+            }
+            hex_reader_close(reader);
+            board_dims[i] = board_dim;
+            total_records += written;
+            input_bytes += input_sizes[i];
+
+            const std::string &name = output_names[i];
+            if (merge) {
+                merged_records[i] = std::move(records);
+                continue;
+            }
+            std::string output = (output_dir / (name + ".hxb")).string();
+            std::string metadata = (output_dir / ("metadata_" + name + ".hxb.csv")).string();
+            bool ok = write_converted_dataset(output, metadata, board_dim, records);
+            std::lock_guard<std::mutex> lock(print_mutex);
+            if (ok) {
+                std::cout << inputs[i] << " -> " << output << " (" << written << " games, " << board_dim << "x" << board_dim << ")" << std::endl;
+            } else {
+                failures++;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 0; t < file_threads; ++t) {
+        workers.emplace_back(convert);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (merge) {
+        std::map<int, std::vector<uint8_t>> by_dim;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (board_dims[i] != 0) {
+                std::vector<uint8_t> &records = by_dim[board_dims[i]];
+                records.insert(records.end(), merged_records[i].begin(), merged_records[i].end());
+                std::vector<uint8_t>().swap(merged_records[i]);
+            }
+        }
+        for (const auto& [board_dim, records] : by_dim) {
+            std::string name = "merged_" + std::to_string(board_dim) + "x" + std::to_string(board_dim);
+            std::string output = (output_dir / (name + ".hxb")).string();
+            if (write_converted_dataset(output, (output_dir / ("metadata_" + name + ".hxb.csv")).string(), board_dim, records)) {
+                std::cout << "Merged " << records.size() / binary_record_size(board_dim) << " games into " << output << std::endl;
+            } else {
+                failures++;
+            }
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "Converted " << total_records << " games from " << inputs.size() - failures << " of " << inputs.size()
+              << " files in " << elapsed.count() << " s (" << input_bytes / elapsed.count() / 1e6 << " MB/s of CSV, "
+              << hex_reader_isa() << " kernels)" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// sketch-merge <sketch|directory>... [--output FILE] [--top N]
+//
+// Merge per-dataset .sketch files, as written next to the metadata, into sweep-level statistics:
+// estimated distinct boards and duplicates, outcomes by starting player, the game-length histogram
+// and the most duplicated boards. Directories contribute their *.sketch files other than the
+// run_{seed}.sketch sweep totals.
+int run_sketch_merge(int argc, char *argv[]) {
+    std::vector<std::string> inputs;
+    int first_option = 2;
+    for (; first_option < argc && std::string(argv[first_option]).rfind("--", 0) != 0; ++first_option) {
+        std::filesystem::path path(argv[first_option]);
+        if (!std::filesystem::is_directory(path)) {
+            inputs.push_back(path.string());
+            continue;
+        }
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            // run_{seed}.sketch already merges the datasets of its sweep
+            if (entry.is_regular_file() && entry.path().extension() == ".sketch" &&
+                entry.path().filename().string().rfind("run_", 0) != 0) {
+                inputs.push_back(entry.path().string());
+            }
+        }
+    }
+    if (inputs.empty()) {
+        print_usage(argv[0], "sketch-merge");
+        return 1;
+    }
+    auto options = parse_options(argc, argv, first_option, {"output", "top"});
+    std::string output_filename = option_or(options, "output", std::string());
+    size_t top = option_or(options, "top", 5LL);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    DatasetSketch merged;
+    DatasetSketch shard;
+    for (const auto& input : inputs) {
+        if (!shard.load(input)) {
+            return 1;
+        }
+        merged.merge(shard);
+    }
+    if (!output_filename.empty() && !merged.save(output_filename)) {
+        return 1;
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    double distinct = merged.distinct_estimate();
+    std::cout << "Merged " << inputs.size() << " sketches (" << merged.shards << " shards, " << merged.records
+              << " records) in " << elapsed.count() << " ms" << std::endl;
+    std::cout << "Board size: " << (merged.board_dim ? std::to_string(merged.board_dim) + "x" + std::to_string(merged.board_dim) : "mixed") << std::endl;
+    std::cout << "Distinct boards: ~" << std::llround(distinct) << " (+-"
+              << std::llround(distinct * 1.04 / std::sqrt(1 << SKETCH_HLL_PRECISION)) << "), duplicate records: ~"
+              << std::llround(merged.records - distinct) << std::endl;
+    for (int p = 0; p < 2; ++p) {
+        std::cout << (p == 0 ? "X" : "O") << " starts: X wins " << merged.outcomes[p][0] << ", O wins "
+                  << merged.outcomes[p][1] << std::endl;
+    }
+
+    uint64_t counted = 0, total_length = 0;
+    int shortest = -1, longest = 0;
+    for (size_t length = 0; length < merged.lengths.size(); ++length) {
+        if (merged.lengths[length] != 0) {
+            shortest = shortest < 0 ? length : shortest;
+            longest = length;
+            counted += merged.lengths[length];
+            total_length += merged.lengths[length] * length;
+        }
+    }
+    if (counted > 0) {
+        std::cout << "Stones on the final board: " << shortest << " to " << longest << ", mean "
+                  << static_cast<double>(total_length) / counted << std::endl;
+        for (int length = shortest; length <= longest; ++length) {
+            if (merged.lengths[length] != 0) {
+                std::cout << "  " << std::setw(3) << length << ": " << merged.lengths[length] << std::endl;
+            }
+        }
+    }
+
+    // Count-min estimates can overcount by about records / SKETCH_CMS_WIDTH * e, so only boards
+    // above that noise floor are reported as duplicated
+    uint64_t noise = std::ceil(merged.records * std::exp(1.0) / SKETCH_CMS_WIDTH);
+    std::vector<DatasetSketch::HotBoard> hot = merged.hot;
+    std::sort(hot.begin(), hot.end(), [](const DatasetSketch::HotBoard &a, const DatasetSketch::HotBoard &b) {
+        return a.count > b.count;
+    });
+    std::cout << "Most duplicated boards (count-min overcount up to " << noise << "):" << std::endl;
+    for (size_t h = 0; h < hot.size() && h < top && hot[h].count > std::max<uint64_t>(noise, 1); ++h) {
+        std::cout << "  ~" << hot[h].count << "  " << std::hex << std::setw(16) << std::setfill('0') << hot[h].board.hash()
+                  << std::dec << std::setfill(' ');
+        if (merged.board_dim != 0) {
+            std::cout << "  " << packed_to_string(hot[h].board, merged.board_dim);
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+const char CATALOG_MAGIC[8] = {'H', 'E', 'X', 'C', 'A', 'T', 'L', '1'};
+const uint32_t CATALOG_VERSION = 1;
+const char *CATALOG_FORMATS[] = {"coord", "string", "binary"};
+const uint8_t CATALOG_FLAG_CHUNKED = 1;
+
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t strings_bytes;   // Size of the name table following the entries
+    uint64_t reserved;
+};
+
+// One dataset of the data directory. Parameters parsed from the file name are -1 for datasets named
+// otherwise, such as merged conversions.
+struct CatalogEntry {
+    uint64_t bytes;           // Data bytes, all chunks and the manifest for a chunked dataset
+    int64_t modified;         // Last write time of the dataset file, in file clock ticks
+    uint64_t records;
+    uint64_t unique_records;
+    uint64_t seed;            // Config seed from the metadata, 0 if unknown
+    uint32_t x_wins;
+    uint32_t o_wins;
+    uint32_t crc32;           // Of the file; a chunked dataset's manifest holds the CRCs of its chunks
+    uint32_t name_offset;     // File name in the name table, relative to the data directory
+    uint32_t split_offset;    // Split name, empty for unsplit datasets
+    uint16_t name_length;
+    uint16_t split_length;
+    int32_t total_games;      // Configured game count
+    int16_t board_dim;
+    int16_t open_percent;
+    int16_t moves_before_end;
+    uint8_t format;           // Index into CATALOG_FORMATS
+    uint8_t flags;
+};
+
+static_assert(sizeof(CatalogHeader) == 32, "CatalogHeader layout changed");
+static_assert(sizeof(CatalogEntry) == 80, "CatalogEntry layout changed");
+
+// Index of every dataset in the data directory, kept in one file so that finding datasets and
+// deciding what a sweep still has to generate never touches the datasets themselves
+struct DatasetCatalog {
+    std::vector<CatalogEntry> entries;
+    std::string strings;
+    std::unordered_map<std::string, size_t> by_name;
+
+    std::string name(const CatalogEntry &entry) const { return strings.substr(entry.name_offset, entry.name_length); }
+    std::string split(const CatalogEntry &entry) const { return strings.substr(entry.split_offset, entry.split_length); }
+
+    const CatalogEntry *find(const std::string &filename) const {
+        auto it = by_name.find(filename);
+        return it == by_name.end() ? nullptr : &entries[it->second];
+    }
+
+    void add(CatalogEntry entry, const std::string &filename, const std::string &split_name) {
+        entry.name_offset = strings.size();
+        entry.name_length = filename.size();
+        strings += filename;
+        entry.split_offset = strings.size();
+        entry.split_length = split_name.size();
+        strings += split_name;
+        by_name[filename] = entries.size();
+        entries.push_back(entry);
+    }
+};
+
+bool save_catalog(const std::string &filename, const DatasetCatalog &catalog) {
+    std::ofstream outfile(filename, std::ios::binary);
+    if (!outfile.is_open()) {
+        std::cerr << "Failed to open catalog file: " << filename << std::endl;
+        return false;
+    }
+    CatalogHeader header = {};
+    std::memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+    header.version = CATALOG_VERSION;
+    header.entry_count = catalog.entries.size();
+    header.strings_bytes = catalog.strings.size();
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outfile.write(reinterpret_cast<const char*>(catalog.entries.data()), catalog.entries.size() * sizeof(CatalogEntry));
+    outfile.write(catalog.strings.data(), catalog.strings.size());
+    return static_cast<bool>(outfile);
+}
+
+bool load_catalog(const std::string &filename, DatasetCatalog &catalog) {
+    std::ifstream infile(filename, std::ios::binary);
+    CatalogHeader header;
+    if (!infile.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, CATALOG_MAGIC, sizeof(header.magic)) != 0 || header.version != CATALOG_VERSION) {
+        return false;
+    }
+    catalog = DatasetCatalog();
+    catalog.entries.resize(header.entry_count);
+    catalog.strings.resize(header.strings_bytes);
+    infile.read(reinterpret_cast<char*>(catalog.entries.data()), catalog.entries.size() * sizeof(CatalogEntry));
+    infile.read(&catalog.strings[0], catalog.strings.size());
+    if (!infile) {
+        return false;
+    }
+    for (size_t e = 0; e < catalog.entries.size(); ++e) {
+        catalog.by_name[catalog.name(catalog.entries[e])] = e;
+    }
+    return true;
+}
+
+// Parameters from a {dim}x{dim}_{games}_{open}_{mbf}[_{split}] file name, without its extension
+bool parse_dataset_name(const std::string &stem, CatalogEntry &entry, std::string &split_name) {
+    int dim, dim2, games, open, mbf, consumed = 0;
+    if (std::sscanf(stem.c_str(), "%dx%d_%d_%d_%d%n", &dim, &dim2, &games, &open, &mbf, &consumed) != 5 || dim != dim2 ||
+        (stem[consumed] != '\0' && stem[consumed] != '_')) {
+        return false;
+    }
+    entry.board_dim = dim;
+    entry.total_games = games;
+    entry.open_percent = open;
+    entry.moves_before_end = mbf;
+    split_name = stem[consumed] == '_' ? stem.substr(consumed + 1) : std::string();
+    return true;
+}
+
+// Counts and seed from a metadata CSV. Older files lack the timestamp (and before that the seed)
+// column, so the fields after Format are told apart by their content.
+bool read_dataset_metadata(const std::string &metadata_filename, CatalogEntry &entry) {
+    std::ifstream infile(metadata_filename);
+    std::string line;
+    if (!std::getline(infile, line) || !std::getline(infile, line)) {
+        return false;
+    }
+    std::vector<std::string> fields;
+    std::stringstream ss(line.substr(0, line.find('{')));
+    for (std::string field; std::getline(ss, field, ',');) {
+        fields.push_back(field);
+    }
+    if (fields.size() < 8) {
+        return false;
+    }
+    auto format = std::find(std::begin(CATALOG_FORMATS), std::end(CATALOG_FORMATS), fields[6]);
+    if (format == std::end(CATALOG_FORMATS)) {
+        return false;
+    }
+    entry.board_dim = std::atoi(fields[1].c_str());
+    entry.records = std::strtoull(fields[2].c_str(), nullptr, 10);
+    entry.unique_records = std::strtoull(fields[3].c_str(), nullptr, 10);
+    entry.x_wins = std::strtoul(fields[4].c_str(), nullptr, 10);
+    entry.o_wins = std::strtoul(fields[5].c_str(), nullptr, 10);
+    entry.format = format - std::begin(CATALOG_FORMATS);
+    size_t next = fields[7].find(':') != std::string::npos ? 8 : 7;  // Skip the timestamp
+    entry.seed = fields.size() > next + 1 ? std::strtoull(fields[next + 1].c_str(), nullptr, 10) : 0;
+    return true;
+}
+
+struct CatalogUpdateStats {
+    size_t reused = 0;         // Unchanged since the previous catalog
+    size_t from_metadata = 0;  // Counts taken from metadata newer than the data
+    size_t analyzed = 0;       // Counted by reading the dataset
+};
+
+// Rescan the data directory in parallel and rewrite the catalog. Entries whose file size and write
+// time are unchanged are kept; other datasets take their counts from metadata newer than the data
+// when there is any, and are only read in full for their checksum otherwise.
+bool update_catalog(const std::string &data_dir, const std::string &metadata_dir, const std::string &catalog_filename,
+                    int threads, DatasetCatalog &catalog, CatalogUpdateStats &stats) {
+    DatasetCatalog previous;
+    load_catalog(catalog_filename, previous);
+
+    const std::string manifest_suffix = ".manifest.csv";
+    auto ends_with = [](const std::string &name, const std::string &suffix) {
+        return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    std::vector<std::string> names;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(data_dir, error)) {
+        std::string name = entry.path().filename().string();
+        bool dataset = ends_with(name, ".hxb") || ends_with(name, manifest_suffix) ||
+                       (ends_with(name, ".csv") && name.find(".part") == std::string::npos);
+        if (entry.is_regular_file() && dataset && name.rfind("metadata_", 0) != 0) {
+            names.push_back(name);
+        }
+    }
+    if (error) {
+        std::cerr << "Failed to scan the data directory: " << data_dir << std::endl;
+        return false;
+    }
+    std::sort(names.begin(), names.end());
+
+    std::vector<CatalogEntry> scanned(names.size());
+    std::vector<std::string> splits(names.size());
+    std::vector<int> sources(names.size(), 0);  // 0 reused, 1 metadata, 2 analyzed
+    std::atomic<size_t> next_name(0);
+    auto scan = [&]() {
+        for (size_t i = next_name++; i < names.size(); i = next_name++) {
+            const std::string &name = names[i];
+            std::string path = data_dir + name;
+            bool chunked = ends_with(name, manifest_suffix);
+            std::string stem = name.substr(0, name.size() - (chunked ? manifest_suffix.size() : 4));
+            CatalogEntry entry = {};
+            entry.total_games = entry.board_dim = entry.open_percent = entry.moves_before_end = -1;
+            parse_dataset_name(stem, entry, splits[i]);
+            entry.flags = chunked ? CATALOG_FLAG_CHUNKED : 0;
+
+            std::error_code error;
+            auto modified = std::filesystem::last_write_time(path, error);
+            entry.modified = modified.time_since_epoch().count();
+            std::vector<std::string> files;
+            if (chunked) {
+                std::ifstream manifest(path);
+                std::string line;
+                std::getline(manifest, line);
+                while (std::getline(manifest, line)) {
+                    size_t name_start = line.find(',') + 1;
+                    files.push_back(data_dir + line.substr(name_start, line.find(',', name_start) - name_start));
+                }
+            } else {
+                files.push_back(path);
+            }
+            entry.bytes = chunked ? std::filesystem::file_size(path, error) : 0;
+            for (const auto& file : files) {
+                uint64_t size = std::filesystem::file_size(file, error);
+                entry.bytes += error ? 0 : size;
+            }
+
+            const CatalogEntry *old = previous.find(name);
+            if (old != nullptr && old->bytes == entry.bytes && old->modified == entry.modified) {
+                scanned[i] = *old;
+                continue;
+            }
+
+            std::string metadata_filename = metadata_dir + "metadata_" + (ends_with(name, ".csv") ? name : name + ".csv");
+            auto metadata_modified = std::filesystem::last_write_time(metadata_filename, error);
+            if (!error && metadata_modified >= modified && read_dataset_metadata(metadata_filename, entry)) {
+                sources[i] = 1;
+            } else {
+                std::string format = "binary";
+                if (!ends_with(name, ".hxb")) {
+                    std::ifstream infile(files.empty() ? path : files[0]);
+                    std::string header;
+                    std::getline(infile, header);
+                    format = header.rfind("board,", 0) == 0 ? "string" : "coord";
+                }
+                auto [total_games, unique_games, wins_player_X, wins_player_O] = analyze_game_file(files, format);
+                entry.records = total_games;
+                entry.unique_records = unique_games;
+                entry.x_wins = wins_player_X;
+                entry.o_wins = wins_player_O;
+                entry.format = std::find(std::begin(CATALOG_FORMATS), std::end(CATALOG_FORMATS), format) - std::begin(CATALOG_FORMATS);
+                sources[i] = 2;
+            }
+            if (entry.board_dim < 0) {
+                DatasetInfo info;
+                read_dataset(path, info, [](const GameRecord&) { return false; });
+                entry.board_dim = info.board_dim;
+            }
+            entry.crc32 = file_crc32(path);
+            scanned[i] = entry;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 0; t < std::max(1, std::min<int>(threads, names.size())); ++t) {
+        workers.emplace_back(scan);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    catalog = DatasetCatalog();
+    for (size_t i = 0; i < names.size(); ++i) {
+        catalog.add(scanned[i], names[i], sources[i] == 0 ? previous.split(scanned[i]) : splits[i]);
+        stats.reused += sources[i] == 0;
+        stats.from_metadata += sources[i] == 1;
+        stats.analyzed += sources[i] == 2;
+    }
+    return save_catalog(catalog_filename, catalog);
+}
+
+// catalog-build [--data-dir DIR] [--metadata-dir DIR] [--catalog FILE] [--threads N] [--rebuild]
+int run_catalog_build(int argc, char *argv[]) {
+    auto options = parse_options(argc, argv, 2, {"data-dir", "metadata-dir", "catalog", "threads", "rebuild"});
+    std::string data_dir = option_or(options, "data-dir", std::string("F:\\TsetlinModels\\data\\"));
+    std::string metadata_dir = option_or(options, "metadata-dir", std::string("F:\\TsetlinModels\\metadata\\"));
+    std::string catalog_filename = option_or(options, "catalog", metadata_dir + "catalog.index");
+    int threads = std::max<long long>(1, option_or(options, "threads", static_cast<long long>(std::thread::hardware_concurrency())));
+    if (options.count("rebuild") != 0) {
+        std::filesystem::remove(catalog_filename);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    DatasetCatalog catalog;
+    CatalogUpdateStats stats;
+    if (!update_catalog(data_dir, metadata_dir, catalog_filename, threads, catalog, stats)) {
+        return 1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "Cataloged " << catalog.entries.size() << " datasets (" << stats.reused << " unchanged, "
+              << stats.from_metadata << " from metadata, " << stats.analyzed << " analyzed) in " << elapsed.count()
+              << " s: " << catalog_filename << std::endl;
+    return 0;
+}
+
+// catalog-query [--dim N] [--min-games N] [--max-games N] [--open N] [--mbf N] [--split NAME]
+//               [--format coord|string|binary] [--paths] [--catalog FILE] [--data-dir DIR]
+//
+// List the cataloged datasets matching every given filter. The game filters apply to the configured
+// game count, or to the record count of datasets whose name does not carry one. --paths prints only
+// the dataset paths, one per line.
+int run_catalog_query(int argc, char *argv[]) {
+    auto options = parse_options(argc, argv, 2, {"data-dir", "catalog", "dim", "min-games", "max-games", "open", "mbf",
+                                                 "split", "format", "paths"});
+    std::string data_dir = option_or(options, "data-dir", std::string("F:\\TsetlinModels\\data\\"));
+    std::string catalog_filename = option_or(options, "catalog", std::string("F:\\TsetlinModels\\metadata\\catalog.index"));
+    long long dim = option_or(options, "dim", -1LL);
+    long long min_games = option_or(options, "min-games", 0LL);
+    long long max_games = option_or(options, "max-games", std::numeric_limits<long long>::max());
+    long long open_percent = option_or(options, "open", -1LL);
+    long long moves_before_end = option_or(options, "mbf", -1LL);
+    std::string split_name = option_or(options, "split", std::string());
+    std::string format = option_or(options, "format", std::string());
+    bool paths_only = options.count("paths") != 0;
+
+    DatasetCatalog catalog;
+    if (!load_catalog(catalog_filename, catalog)) {
+        std::cerr << "No catalog at " << catalog_filename << ", run catalog-build first" << std::endl;
+        return 1;
+    }
+
+    uint64_t matches = 0, records = 0, bytes = 0;
+    for (const CatalogEntry &entry : catalog.entries) {
+        long long games = entry.total_games >= 0 ? entry.total_games : static_cast<long long>(entry.records);
+        if ((dim >= 0 && entry.board_dim != dim) || games < min_games || games > max_games ||
+            (open_percent >= 0 && entry.open_percent != open_percent) ||
+            (moves_before_end >= 0 && entry.moves_before_end != moves_before_end) ||
+            (options.count("split") != 0 && catalog.split(entry) != split_name) ||
+            (!format.empty() && format != CATALOG_FORMATS[entry.format])) {
+            continue;
+        }
+        matches++;
+        records += entry.records;
+        bytes += entry.bytes;
+        if (paths_only) {
+            std::cout << data_dir << catalog.name(entry) << std::endl;
+            continue;
+        }
+        std::cout << std::left << std::setw(36) << catalog.name(entry) << std::right << " " << std::setw(2) << entry.board_dim
+                  << "x" << std::setw(2) << entry.board_dim << " " << std::setw(6) << CATALOG_FORMATS[entry.format]
+                  << std::setw(10) << entry.records << " records" << std::setw(10) << entry.unique_records << " unique"
+                  << std::setw(9) << entry.x_wins << " X" << std::setw(9) << entry.o_wins << " O" << std::setw(13)
+                  << entry.bytes << " bytes  crc32 " << std::hex << std::setw(8) << std::setfill('0') << entry.crc32
+                  << std::dec << std::setfill(' ') << std::endl;
+    }
+    if (!paths_only) {
+        std::cout << matches << " of " << catalog.entries.size() << " datasets, " << records << " records, " << bytes
+                  << " bytes" << std::endl;
+    }
+    return 0;
+}
+
+// Discards dataset output, so a benchmark point measures simulation and encoding alone
+class NullFileWriter : public FileWriter {
+public:
+    uint64_t bytes = 0;
+
+    bool open(const std::string &, uint64_t) override {
+        bytes = 0;
+        return true;
+    }
+
+    bool write(const char *, size_t size) override {
+        bytes += size;
+        return true;
+    }
+
+    bool close() override {
+        return true;
+    }
+};
+
+// One measurement of bench-scaling: a slice config run at one thread count into one sink
+struct ScalingPoint {
+    int board_dim;
+    int open_percent;
+    std::string sink;        // "null", "tmpfs" or "disk"
+    int threads;
+    long long playouts = 0;
+    long long games = 0;     // Valid, distinct games written
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    double efficiency = 0.0; // Speedup over the fewest threads measured, divided by the added thread factor
+    double vs_null = 0.0;    // Throughput relative to the null sink at the same point, what is left after I/O
+};
+
+std::vector<int> parse_int_list(const std::string &text, const std::string &name) {
+    std::vector<int> values;
+    std::stringstream ss(text);
+    for (std::string field; std::getline(ss, field, ',');) {
+        if (!field.empty()) {
+            values.push_back(parse_integer(field, name));
+        }
+    }
+    return values;
+}
+
+// Run the sweep's ordered pipeline (playout workers, in-order commit with deduplication, CSV encode
+// and write stages) for a fixed number of playouts, writing into directory unless the sink is null.
+// Game i depends only on the config seed, so every thread count and sink produces the same games.
+bool run_scaling_point(ScalingPoint &point, long long playouts, const std::string &directory,
+                       const std::string &writer_backend, bool direct_io, int encode_threads, uint64_t seed) {
+    int open_pos = point.board_dim * point.board_dim * point.open_percent / 100;
+    uint64_t dataset_seed = config_seed(seed, point.board_dim, static_cast<int>(playouts), point.open_percent, 0);
+    PlayoutSettings settings = {point.board_dim, dataset_seed, open_pos, 0, false, false, {}, false, false};
+
+    std::string filename;
+    std::vector<std::unique_ptr<FileWriter>> writers;
+    NullFileWriter *null_writer = nullptr;
+    if (point.sink == "null") {
+        null_writer = new NullFileWriter();
+        writers.emplace_back(null_writer);
+    } else {
+        filename = (std::filesystem::path(directory) / ("bench_" + std::to_string(point.board_dim) + "x" +
+                    std::to_string(point.board_dim) + "_" + std::to_string(point.open_percent) + "_" +
+                    std::to_string(point.threads) + ".csv")).string();
+        writers.push_back(FileWriter::create(writer_backend, direct_io));
+    }
+    if (!writers[0]->open(filename, estimate_csv_bytes("coord", point.board_dim, playouts))) {
+        std::cerr << "Failed to create benchmark file: " << filename << std::endl;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool write_ok;
+    {
+        StageMetrics commit_metrics("commit", 1);
+        PlayoutGenerator generator(settings, point.threads, commit_metrics);
+        CsvOutputPipeline output(writers, "coord", point.board_dim, false, false, encode_threads, 16);
+        std::unordered_set<std::string> unique_games;
+        std::vector<GameRecord> game_results;
+        while (point.playouts < playouts) {
+            for (PlayoutResult &result : generator.next_block()) {
+                if (point.playouts >= playouts) {
+                    break;
+                }
+                point.playouts++;
+                if (!result.valid || !unique_games.insert(std::move(result.board_key)).second) {
+                    continue;
+                }
+                game_results.push_back({result.board, result.starting_player, result.winner, SYMMETRY_IDENTITY, 0,
+                                        result.game_index});
+                point.games++;
+                if (game_results.size() >= 4096) {
+                    output.submit(std::move(game_results));
+                    game_results.clear();
+                }
+            }
+        }
+        generator.stop();
+        output.submit(std::move(game_results));
+        write_ok = output.finish();
+    }
+    write_ok = writers[0]->close() && write_ok;
+    point.seconds = nanoseconds_since(start) / 1e9;
+    if (null_writer != nullptr) {
+        point.bytes = null_writer->bytes;
+    } else {
+        std::error_code ec;
+        point.bytes = std::filesystem::file_size(filename, ec);
+        std::filesystem::remove(filename, ec);
+    }
+    if (!write_ok) {
+        std::cerr << "Error writing benchmark file: " << filename << std::endl;
+    }
+    return write_ok;
+}
+
+// bench-scaling [--min-dim N] [--max-dim N] [--dim-step N] [--open 10,20,30,40] [--threads 1,2,4,...]
+//               [--sinks null,tmpfs,disk] [--playouts N] [--tmpfs-dir DIR] [--disk-dir DIR]
+//               [--backend ofstream|posix|uring] [--direct-io] [--encode-threads N] [--out PREFIX]
+//
+// Thread-scaling matrix of the generation pipeline. Every dim and open fraction of the slice runs the
+// same playouts at each thread count (powers of two up to the hardware threads by default) into each
+// sink: "null" discards the CSV text, "tmpfs" writes to a RAM-backed directory and "disk" to the data
+// drive, so comparing sinks separates the I/O cost from simulation. Writes {out}.csv with one row per
+// point and {out}.json with the points plus, per dim, open fraction and sink, the peak rate and the
+// thread count where scaling stops: the last one whose added threads still returned at least half
+// their share of the base rate. Without --direct-io short runs may never leave the page cache.
+int run_bench_scaling(int argc, char *argv[]) {
+    auto options = parse_options(argc, argv, 2, {"min-dim", "max-dim", "dim-step", "open", "threads", "sinks", "playouts",
+                                                 "tmpfs-dir", "disk-dir", "backend", "direct-io", "encode-threads", "out"});
+    long long min_dim = option_or(options, "min-dim", 4LL);
+    long long max_dim = option_or(options, "max-dim", 15LL);
+    int dim_step = std::max<long long>(1, option_or(options, "dim-step", 1LL));
+    std::vector<int> open_percents = parse_int_list(option_or(options, "open", std::string("10,20,30,40")), "--open");
+    long long playouts = std::max<long long>(1, option_or(options, "playouts", 20000LL));
+    int encode_threads = std::max<long long>(1, option_or(options, "encode-threads", 2LL));
+    std::string writer_backend = option_or(options, "backend", std::string("ofstream"));
+    bool direct_io = options.count("direct-io") != 0;
+#ifdef __linux__
+    std::string tmpfs_dir = option_or(options, "tmpfs-dir", std::string("/dev/shm"));
+#else
+    std::string tmpfs_dir = option_or(options, "tmpfs-dir", std::string());
+#endif
+    std::string disk_dir = option_or(options, "disk-dir", std::string("F:\\TsetlinModels\\data\\"));
+    uint64_t seed = time(nullptr);
+    std::string out_prefix = option_or(options, "out", "F:\\TsetlinModels\\metadata\\scaling_" + std::to_string(seed));
+
+    int hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> thread_counts;
+    if (options.count("threads") != 0) {
+        thread_counts = parse_int_list(options["threads"], "--threads");
+    } else {
+        for (int t = 1; t < hardware_threads; t *= 2) {
+            thread_counts.push_back(t);
+        }
+        thread_counts.push_back(hardware_threads);
+    }
+    std::sort(thread_counts.begin(), thread_counts.end());
+    thread_counts.erase(std::unique(thread_counts.begin(), thread_counts.end()), thread_counts.end());
+    thread_counts.erase(std::remove_if(thread_counts.begin(), thread_counts.end(), [](int t) { return t < 1; }),
+                        thread_counts.end());
+
+    // Null first, so the other sinks can be related to it
+    std::vector<std::pair<std::string, std::string>> sinks;
+    std::stringstream sink_list(option_or(options, "sinks", std::string("null,tmpfs,disk")));
+    for (std::string sink; std::getline(sink_list, sink, ',');) {
+        std::string directory = sink == "tmpfs" ? tmpfs_dir : sink == "disk" ? disk_dir : std::string();
+        if (sink != "null" && sink != "tmpfs" && sink != "disk") {
+            std::cerr << "Unknown sink: " << sink << std::endl;
+            return 1;
+        }
+        if (sink != "null" && (directory.empty() || !std::filesystem::is_directory(directory))) {
+            std::cerr << "Skipping the " << sink << " sink, no directory: " << directory << std::endl;
+            continue;
+        }
+        sinks.emplace_back(sink, directory);
+    }
+    std::stable_sort(sinks.begin(), sinks.end(), [](const auto &a, const auto &b) {
+        return a.first == "null" && b.first != "null";
+    });
+    if (thread_counts.empty() || sinks.empty() || open_percents.empty() || min_dim > max_dim) {
+        std::cerr << "Nothing to benchmark" << std::endl;
+        return 1;
+    }
+
+    if (min_dim < 1 || max_dim > MAX_PACKED_DIM) {
+        std::cerr << "Board dims must lie in 1.." << MAX_PACKED_DIM << std::endl;
+        return 1;
+    }
+    if (playouts > std::numeric_limits<int>::max()) {
+        std::cerr << "At most " << std::numeric_limits<int>::max() << " playouts per point" << std::endl;
+        return 1;
+    }
+
+    std::vector<ScalingPoint> points;
+    std::ostringstream groups;
+    for (int board_dim = min_dim; board_dim <= max_dim; board_dim += dim_step) {
+        for (int open_percent : open_percents) {
+            std::map<int, double> null_seconds;  // By thread count
+            for (const auto &[sink, directory] : sinks) {
+                size_t first = points.size();
+                for (int threads : thread_counts) {
+                    ScalingPoint point = {board_dim, open_percent, sink, threads};
+                    if (!run_scaling_point(point, playouts, directory, writer_backend, direct_io, encode_threads, seed)) {
+                        return 1;
+                    }
+                    const ScalingPoint &base = points.size() > first ? points[first] : point;
+                    point.efficiency = base.seconds / point.seconds * base.threads / threads;
+                    if (sink == "null") {
+                        null_seconds[threads] = point.seconds;
+                    }
+                    if (null_seconds.count(threads) != 0) {
+                        point.vs_null = null_seconds[threads] / point.seconds;
+                    }
+                    std::cout << std::setw(2) << board_dim << "x" << std::setw(2) << board_dim << " " << std::setw(2)
+                              << open_percent << "% " << std::left << std::setw(5) << sink << std::right << std::setw(4)
+                              << threads << " threads: " << std::setw(10) << static_cast<long long>(point.games / point.seconds)
+                              << " games/s " << std::setw(10) << static_cast<long long>(point.playouts / point.seconds)
+                              << " playouts/s  efficiency " << std::setw(4) << static_cast<int>(point.efficiency * 100 + 0.5)
+                              << "%" << std::endl;
+                    points.push_back(point);
+                }
+
+                // Scaling stops at the last thread count whose added threads still returned half of the
+                // per-thread rate of the smallest count; every point ran the same games, so rates are 1 / seconds
+                double thread_rate = 1.0 / (points[first].seconds * points[first].threads);
+                size_t knee = first;
+                size_t peak = first;
+                for (size_t p = first + 1; p < points.size(); ++p) {
+                    double gain = 1.0 / points[p].seconds - 1.0 / points[p - 1].seconds;
+                    if (knee == p - 1 && gain >= 0.5 * thread_rate * (points[p].threads - points[p - 1].threads)) {
+                        knee = p;
+                    }
+                    if (points[p].seconds < points[peak].seconds) {
+                        peak = p;
+                    }
+                }
+                std::cout << " - " << sink << ": peak " << static_cast<long long>(points[peak].games / points[peak].seconds)
+                          << " games/s at " << points[peak].threads << " threads, scaling stops at "
+                          << points[knee].threads << " threads" << std::endl;
+                groups << (groups.tellp() > 0 ? "," : "") << "{\"board_dim\":" << board_dim << ",\"open_percent\":"
+                       << open_percent << ",\"sink\":" << json_string(sink) << ",\"peak_games_per_s\":"
+                       << points[peak].games / points[peak].seconds << ",\"peak_threads\":" << points[peak].threads
+                       << ",\"scaling_stops_at\":" << points[knee].threads << ",\"efficiency_at_peak\":"
+                       << points[peak].efficiency << "}";
+            }
+        }
+    }
+
+    std::ofstream csv_file(out_prefix + ".csv");
+    std::ofstream json_file(out_prefix + ".json");
+    if (!csv_file.is_open() || !json_file.is_open()) {
+        std::cerr << "Failed to open benchmark output: " << out_prefix << ".csv/.json" << std::endl;
+        return 1;
+    }
+    csv_file << "board_dim,open_percent,sink,threads,playouts,games,bytes,seconds,games_per_s,playouts_per_s,"
+             << "bytes_per_s,efficiency,vs_null\n";
+    json_file << "{\"host\":" << json_string(host_name()) << ",\"engine\":" << json_string(ENGINE_ID)
+              << ",\"hardware_threads\":" << hardware_threads << ",\"encode_threads\":" << encode_threads
+              << ",\"backend\":" << json_string(writer_backend) << ",\"direct_io\":" << (direct_io ? "true" : "false")
+              << ",\"playouts_per_point\":" << playouts << ",\"seed\":" << seed << ",\"points\":[";
+    for (size_t p = 0; p < points.size(); ++p) {
+        const ScalingPoint &point = points[p];
+        csv_file << point.board_dim << "," << point.open_percent << "," << point.sink << "," << point.threads << ","
+                 << point.playouts << "," << point.games << "," << point.bytes << "," << point.seconds << ","
+                 << point.games / point.seconds << "," << point.playouts / point.seconds << ","
+                 << point.bytes / point.seconds << "," << point.efficiency << "," << point.vs_null << "\n";
+        json_file << (p == 0 ? "" : ",") << "{\"board_dim\":" << point.board_dim << ",\"open_percent\":"
+                  << point.open_percent << ",\"sink\":" << json_string(point.sink) << ",\"threads\":" << point.threads
+                  << ",\"playouts\":" << point.playouts << ",\"games\":" << point.games << ",\"bytes\":" << point.bytes
+                  << ",\"seconds\":" << point.seconds << ",\"games_per_s\":" << point.games / point.seconds
+                  << ",\"efficiency\":" << point.efficiency << ",\"vs_null\":" << point.vs_null << "}";
+    }
+    json_file << "],\"groups\":[" << groups.str() << "]}" << std::endl;
+    std::cout << "Wrote " << points.size() << " points to " << out_prefix << ".csv and " << out_prefix << ".json" << std::endl;
+    return 0;
+}
+
+// Outcome statistics of one engine over the games of a dim, for engine-diff
+struct EngineStats {
+    long long games = 0;
+    long long x_wins = 0;
+    long long starter_wins = 0;
+    std::vector<long long> lengths;  // Games by plies played
+
+    void add(int starting_player, int winner, int length) {
+        games++;
+        x_wins += winner == 0;
+        starter_wins += winner == starting_player;
+        if (static_cast<int>(lengths.size()) <= length) {
+            lengths.resize(length + 1);
+        }
+        lengths[length]++;
+    }
+
+    void merge(const EngineStats &other) {
+        games += other.games;
+        x_wins += other.x_wins;
+        starter_wins += other.starter_wins;
+        if (lengths.size() < other.lengths.size()) {
+            lengths.resize(other.lengths.size());
+        }
+        for (size_t l = 0; l < other.lengths.size(); ++l) {
+            lengths[l] += other.lengths[l];
+        }
+    }
+};
+
+// Two-sample z statistic for a difference between proportions
+double proportion_z(long long hits_a, long long n_a, long long hits_b, long long n_b) {
+    double pooled = static_cast<double>(hits_a + hits_b) / (n_a + n_b);
+    double se = std::sqrt(pooled * (1.0 - pooled) * (1.0 / n_a + 1.0 / n_b));
+    return se > 0.0 ? (static_cast<double>(hits_a) / n_a - static_cast<double>(hits_b) / n_b) / se : 0.0;
+}
+
+// Chi-square homogeneity test of two length histograms, merging sparse lengths until every bin
+// expects at least 5 games, turned into a z score by the Wilson-Hilferty transform
+double length_distribution_z(const EngineStats &a, const EngineStats &b) {
+    double n_a = a.games, n_b = b.games;
+    double chi_square = 0.0;
+    int bins = 0;
+    long long bin_a = 0, bin_b = 0;
+    size_t length_count = std::max(a.lengths.size(), b.lengths.size());
+    for (size_t l = 0; l < length_count; ++l) {
+        bin_a += l < a.lengths.size() ? a.lengths[l] : 0;
+        bin_b += l < b.lengths.size() ? b.lengths[l] : 0;
+        double total = bin_a + bin_b;
+        bool last = l + 1 == length_count;
+        if (total * std::min(n_a, n_b) / (n_a + n_b) < 5.0 && !last) {
+            continue;
+        }
+        double expected_a = total * n_a / (n_a + n_b);
+        double expected_b = total * n_b / (n_a + n_b);
+        if (expected_a > 0.0 && expected_b > 0.0) {
+            chi_square += (bin_a - expected_a) * (bin_a - expected_a) / expected_a +
+                          (bin_b - expected_b) * (bin_b - expected_b) / expected_b;
+            bins++;
+        }
+        bin_a = bin_b = 0;
+    }
+    int df = bins - 1;
+    if (df < 1) {
+        return 0.0;
+    }
+    double scale = 2.0 / (9.0 * df);
+    return (std::cbrt(chi_square / df) - (1.0 - scale)) / std::sqrt(scale);
+}
+
+// First difference found by engine-diff and the number of differing games
+struct EngineMismatch {
+    uint64_t game_index = std::numeric_limits<uint64_t>::max();
+    std::string what;
+    long long games = 0;
+
+    void record(uint64_t index, const std::string &description) {
+        games++;
+        if (index < game_index) {
+            game_index = index;
+            what = description;
+        }
+    }
+};
+
+// Play games [first, last) of a dim on HexGame and on the candidate. With exact, both follow the same
+// streams and every game must agree in starting player, winner, move list, final and truncated
+// board and removed moves; otherwise the candidate plays its own streams and only the outcome
+// statistics are gathered. Dataset rows are encoded from exactly these fields by HexGame alone, so
+// they are not compared separately.
+template <typename Candidate>
+void diff_engine_games(HexGame &reference, Candidate &candidate, uint64_t seed, int moves_before_end, bool exact,
+                       uint64_t first, uint64_t last, EngineStats &reference_stats, EngineStats &candidate_stats,
+                       EngineMismatch &mismatch) {
+    uint64_t candidate_seed = exact ? seed : PackedBoard::mix64(seed ^ 0xC2B2AE3D27D4EB4FULL);
+    for (uint64_t game_index = first; game_index < last; ++game_index) {
+        int reference_starter, candidate_starter;
+        int reference_winner = play_random_game(reference, seed, game_index, reference_starter);
+        int candidate_winner = play_random_game(candidate, candidate_seed, game_index, candidate_starter);
+        reference_stats.add(reference_starter, reference_winner, reference.moves.size());
+        candidate_stats.add(candidate_starter, candidate_winner, candidate.moves.size());
+        if (!exact) {
+            continue;
+        }
+
+        std::string what;
+        if (candidate_starter != reference_starter || candidate_winner != reference_winner) {
+            what = "starting player or winner";
+        } else if (candidate.moves != reference.moves) {
+            what = "move list";
+        } else if (!(candidate.pack_board() == reference.pack_board())) {
+            what = "final board";
+        } else {
+            int n = std::min<int>(moves_before_end, reference.moves.size());
+            if (candidate.remove_last_n_moves(n) != reference.remove_last_n_moves(n)) {
+                what = "removed moves";
+            } else if (!(candidate.pack_board() == reference.pack_board())) {
+                what = "truncated board";
+            }
+        }
+        if (!what.empty()) {
+            mismatch.record(game_index, what);
+        }
+    }
+}
+
+// Run games [0, games) of a dim through diff_engine_games on all threads; false on any mismatch or,
+// for engines that are not bit-exact, on a winner rate or length distribution beyond z_limit
+template <typename Candidate>
+bool diff_engine(int board_dim, uint64_t seed, long long games, int moves_before_end, bool exact, bool statistics,
+                 double z_limit, int threads) {
+    const uint64_t chunk = 4096;
+    std::atomic<uint64_t> next_chunk{0};
+    std::mutex mutex;
+    EngineStats reference_stats, candidate_stats;
+    EngineMismatch mismatch;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            HexGame reference(board_dim);
+            Candidate candidate(board_dim);
+            EngineStats local_reference, local_candidate;
+            EngineMismatch local_mismatch;
+            for (uint64_t first = next_chunk++ * chunk; first < static_cast<uint64_t>(games); first = next_chunk++ * chunk) {
+                diff_engine_games(reference, candidate, seed, moves_before_end, exact, first,
+                                  std::min<uint64_t>(first + chunk, games), local_reference, local_candidate, local_mismatch);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            reference_stats.merge(local_reference);
+            candidate_stats.merge(local_candidate);
+            mismatch.games += local_mismatch.games;
+            if (local_mismatch.game_index < mismatch.game_index) {
+                mismatch.game_index = local_mismatch.game_index;
+                mismatch.what = local_mismatch.what;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    bool passed = mismatch.games == 0;
+    std::cout << std::setw(2) << board_dim << "x" << std::setw(2) << board_dim << ": " << games << " games in "
+              << nanoseconds_since(start) / 1e9 << " s";
+    if (exact) {
+        std::cout << ", " << mismatch.games << " mismatches";
+        if (mismatch.games != 0) {
+            std::cout << " (first: " << mismatch.what << " of game " << mismatch.game_index << ")";
+        }
+    }
+    if (statistics) {
+        double x_wins_z = proportion_z(candidate_stats.x_wins, candidate_stats.games, reference_stats.x_wins, reference_stats.games);
+        double starter_z = proportion_z(candidate_stats.starter_wins, candidate_stats.games, reference_stats.starter_wins,
+                                        reference_stats.games);
+        double length_z = length_distribution_z(candidate_stats, reference_stats);
+        passed = passed && std::abs(x_wins_z) <= z_limit && std::abs(starter_z) <= z_limit && length_z <= z_limit;
+        std::cout << ", X wins " << 100.0 * candidate_stats.x_wins / candidate_stats.games << "% vs "
+                  << 100.0 * reference_stats.x_wins / reference_stats.games << "% (z " << x_wins_z << "), starter wins "
+                  << 100.0 * candidate_stats.starter_wins / candidate_stats.games << "% vs "
+                  << 100.0 * reference_stats.starter_wins / reference_stats.games << "% (z " << starter_z
+                  << "), lengths z " << length_z;
+    }
+    std::cout << (passed ? "  PASS" : "  FAIL") << std::endl;
+    return passed;
+}
+
+// engine-diff [--engine union-find] [--min-dim N] [--max-dim N] [--games N] [--mbf N] [--seed N]
+//             [--stats] [--z-limit Z] [--threads N]
+//
+// Differential test of a candidate playout engine against HexGame, which defines the datasets. A
+// bit-exact engine replays the same counter-based streams as the reference and must agree on every
+// game (starting player, winner, moves, final and truncated boards, removed moves). Engines
+// that are not bit-exact, or any engine with --stats, are held to the reference's statistics from
+// independent streams: X and starting-player win rates by two-proportion z tests and the game-length
+// distribution by a chi-square test, each within --z-limit (default 5, so that millions of games
+// over a dozen dims do not fail by chance). Exits with 1 unless every dim passes.
+int run_engine_diff(int argc, char *argv[]) {
+    auto options = parse_options(argc, argv, 2, {"engine", "min-dim", "max-dim", "games", "mbf", "seed", "stats",
+                                                 "z-limit", "threads"});
+    std::string engine = option_or(options, "engine", std::string("union-find"));
+    long long min_dim = option_or(options, "min-dim", 4LL);
+    long long max_dim = option_or(options, "max-dim", 15LL);
+    long long games = std::max<long long>(1, option_or(options, "games", 1000000LL));
+    int moves_before_end = std::max<long long>(0, option_or(options, "mbf", 2LL));
+    uint64_t seed = option_or(options, "seed", static_cast<long long>(time(nullptr)));
+    double z_limit = option_or(options, "z-limit", 5.0);
+    int threads = std::max<long long>(1, option_or(options, "threads", static_cast<long long>(std::thread::hardware_concurrency())));
+
+    // Candidate engines and whether they promise identical games
+    bool exact;
+    if (engine == "union-find") {
+        exact = true;
+    } else {
+        std::cerr << "Unknown engine: " << engine << std::endl;
+        std::cerr << "Engines: union-find" << std::endl;
+        return 1;
+    }
+    if (min_dim < 1 || max_dim > MAX_PACKED_DIM || min_dim > max_dim) {
+        std::cerr << "Board dims must form a range within 1.." << MAX_PACKED_DIM << std::endl;
+        return 1;
+    }
+    bool statistics = !exact || options.count("stats") != 0;
+    std::cout << "Comparing " << engine << " with the reference engine, seed " << seed << std::endl;
+
+    bool passed = true;
+    for (int board_dim = min_dim; board_dim <= max_dim; ++board_dim) {
+        if (exact) {
+            passed = diff_engine<UnionFindHexGame>(board_dim, seed, games, moves_before_end, true, false, z_limit, threads) && passed;
+        }
+        if (statistics) {
+            passed = diff_engine<UnionFindHexGame>(board_dim, seed, games, moves_before_end, false, true, z_limit, threads) && passed;
+        }
+    }
+    std::cout << (passed ? "All dims passed" : "Engine differs from the reference") << std::endl;
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    setvbuf(stdout, NULL, _IONBF, 0);  // Disable output buffering
+
+    // --isa avx512|avx2|scalar, anywhere on the command line, pins the vectorized kernels of the
+    // dataset reader instead of the widest set the CPU supports, e.g. to benchmark them
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--isa") {
+            if (!hex_reader_select_isa(argv[i + 1])) {
+                std::cerr << hex_reader_last_error() << std::endl;
+                return 1;
+            }
+            std::copy(argv + i + 2, argv + argc, argv + i);
+            argc -= 2;
+            break;
+        }
+    }
+
+    // Tools working on existing data; without a command the generation sweep runs. Unknown options and
+    // malformed numbers surface from the argument parsers as std::invalid_argument.
+    if (argc > 1) {
+        std::string command = argv[1];
+        try {
+            if (command == "corpus-index") {
+                return run_corpus_index(argc, argv);
+            }
+            if (command == "corpus-query") {
+                return run_corpus_query(argc, argv);
+            }
+            if (command == "dataset-setop") {
+                return run_dataset_setop(argc, argv);
+            }
+            if (command == "dataset-convert") {
+                return run_dataset_convert(argc, argv);
+            }
+            if (command == "sketch-merge") {
+                return run_sketch_merge(argc, argv);
+            }
+            if (command == "catalog-build") {
+                return run_catalog_build(argc, argv);
+            }
+            if (command == "catalog-query") {
+                return run_catalog_query(argc, argv);
+            }
+            if (command == "bench-scaling") {
+                return run_bench_scaling(argc, argv);
+            }
+            if (command == "engine-diff") {
+                return run_engine_diff(argc, argv);
+            }
+            std::cerr << "Unknown command: " << command << std::endl;
+            std::cerr << "Commands: corpus-index, corpus-query, dataset-setop, dataset-convert, sketch-merge, catalog-build,"
+                      << " catalog-query, bench-scaling, engine-diff" << std::endl;
+            return 1;
+        } catch (const std::invalid_argument &error) {
+            std::cerr << error.what() << std::endl;
+            print_usage(argv[0], command);
+            return 1;
+        }
+    }
+
+    srand(time(nullptr));
+    uint64_t seed = time(nullptr);  // Run seed; game i of a config is fully determined by (config seed, i)
+    std::cout << "Seed: " << seed << std::endl;
+
+    // Ensure 'data' and 'metadata' directories exist
+    ensure_directory_exists("F:\\TsetlinModels\\data");
+    ensure_directory_exists("F:\\TsetlinModels\\metadata");
+    ensure_directory_exists("F:\\TsetlinModels\\corpus");
+
+    std::string format = "coord";
+    bool export_graph = false;      // Also write {dataset}.graph.bin for Graph Tsetlin Machines
+    bool graph_group_ids = false;   // Include per-node stone group IDs in the graph export
+    bool export_patches = false;    // Also write {dataset}.patches.bin with bit-packed convolution patches
+    int patch_size = 3;
+    int patch_stride = 1;
+    int patch_padding = 1;          // Cells of hex-edge padding around the board
+    bool augment_symmetries = false; // Also write the distinct symmetric variants of each game, flagged in a symmetry column
+    bool stratified_sampling = false; // Accept games only into winner x starting player x length strata with room left
+    int length_buckets = 2;
+    std::vector<int> stratum_quotas = {}; // Per-stratum weights, scaled to each total_games; empty for an even split
+    long long quota_report_interval = 1000000;  // Playouts between slow-stratum reports
+    long long quota_give_up_playouts = 10000000; // Stop after this many playouts without an accepted game
+    bool split_output = false;      // Write {dataset}_{split}.csv files, assigned by hashing each game's canonical final board
+    std::vector<std::string> split_names = {"train", "val", "test"};
+    std::vector<double> split_fractions = {0.8, 0.1, 0.1};
+    bool game_index_column = false; // Add a game_index column so rows can be regenerated from the config seed
+    int num_threads = std::max(1u, std::thread::hardware_concurrency());  // Playout workers; output does not depend on it
+    bool export_positions = false;  // Also write {dataset}.positions.bin with every intermediate position of each game
+    int position_ply_stride = 1;    // Keep every n-th ply of the position stream
+    bool append_corpus = false;     // Append every playout to corpus/corpus_{dim}x{dim}.games for later corpus-query runs
+    std::string writer_backend = "ofstream";  // Dataset CSV output: "ofstream", or on Linux "posix" or "uring"
+    bool writer_direct_io = false;  // O_DIRECT for the Linux backends, bypassing the page cache
+    uint64_t chunk_records = 0;     // Roll dataset CSVs into chunk files of this many rows plus a manifest, 0 for one file
+    uint64_t chunk_bytes = 0;       // Or of at most this many bytes
+    int encode_threads = 2;         // Threads formatting CSV rows; the commit and write stages have one each
+    int pipeline_queue_batches = 16; // Capacity of the queues between the stages, in batches
+    bool report_pipeline_metrics = false; // Print per-stage busy, starved and blocked time and queue occupancy
+    bool fixed_record_output = false; // Write {dataset}.hxb binary records straight from the workers in completion
+                                      // order; fastest, but not reproducible and without splits, augmentation or exports
+    bool write_run_manifest = true; // Append provenance, counts, timings and checksums to metadata/run_{seed}.jsonl
+    bool perf_counters = false;     // Count cycles, instructions, cache and branch misses per stage (Linux perf events)
+    bool trace_timeline = false;    // Record a Chrome/Perfetto timeline of the sweep to metadata/trace_{seed}.json
+    bool memory_accounting = false; // Count heap allocations and report each config's memory by structure
+    uint64_t memory_budget_bytes = 0; // Resident memory at which a config compacts its duplicate set and spills
+                                      // removed moves to disk instead of growing further, 0 for no limit
+    size_t trace_buffer_events = 1 << 16;  // Newest spans kept per thread
+
+
+    int total_games_list[] = {2000, 20000, 200000}; //,
+    int min_board_dim = 4;
+    int max_board_dim = 15;
+    float open_pos_list[] = {0.1,0.2,0.3,0.4}; // 0.00,0.05,0.1,0.15,0.2,0.25,0.3,0.35,0.4,0.45,,0.5
+    int mbf_list[] = {0}; //,2,5
+
+    if (stratified_sampling && !StratumQuotas::valid_weights(stratum_quotas, length_buckets)) {
+        std::cerr << "Stratum quotas need " << 4 * length_buckets << " non-negative weights with a positive sum" << std::endl;
+        return 1;
+    }
+
+    // Settings that shape the rows of a chunked dataset; a journal written under others is not resumed
+    std::ostringstream resume_settings;
+    resume_settings << "format=" << format << " augment_symmetries=" << augment_symmetries
+                    << " game_index_column=" << game_index_column << " chunk_records=" << chunk_records
+                    << " chunk_bytes=" << chunk_bytes << " stratified_sampling=" << stratified_sampling
+                    << " length_buckets=" << length_buckets << " quota_give_up_playouts=" << quota_give_up_playouts
+                    << " stratum_quotas=";
+    for (size_t s = 0; s < stratum_quotas.size(); ++s) {
+        resume_settings << (s ? "," : "") << stratum_quotas[s];
+    }
+
+    tracing_enabled = trace_timeline;
+    allocation_counting = memory_accounting;
+    TraceLog::capacity = trace_buffer_events;
+    TraceLog::name_thread("main");
+
+    // Datasets already generated come from the catalog, refreshed once per sweep
+    DatasetCatalog catalog;
+    CatalogUpdateStats catalog_stats;
+    auto catalog_start = std::chrono::steady_clock::now();
+    update_catalog("F:\\TsetlinModels\\data\\", "F:\\TsetlinModels\\metadata\\",
+                   "F:\\TsetlinModels\\metadata\\catalog.index", num_threads, catalog, catalog_stats);
+    TraceLog::record("catalog", "sweep", catalog_start, catalog.entries.size());
+
+    perf_counters_enabled = perf_counters;
+    if (perf_counters) {
+        PerfCounters::local();  // Opens the main thread's counters, saying so up front if they are unavailable
+    }
+    RunManifest manifest;
+    int skipped_configs = 0;
+    DatasetSketch run_sketch;  // Merged from the per-dataset sketches
+    if (write_run_manifest) {
+        std::ostringstream settings_json;
+        settings_json << std::boolalpha << "{\"format\":" << json_string(format) << ",\"threads\":" << num_threads
+                      << ",\"min_board_dim\":" << min_board_dim << ",\"max_board_dim\":" << max_board_dim
+                      << ",\"augment_symmetries\":" << augment_symmetries << ",\"stratified_sampling\":" << stratified_sampling
+                      << ",\"length_buckets\":" << length_buckets << ",\"split_output\":" << split_output
+                      << ",\"game_index_column\":" << game_index_column << ",\"writer_backend\":" << json_string(writer_backend)
+                      << ",\"writer_direct_io\":" << writer_direct_io << ",\"chunk_records\":" << chunk_records
+                      << ",\"chunk_bytes\":" << chunk_bytes << ",\"encode_threads\":" << encode_threads
+                      << ",\"pipeline_queue_batches\":" << pipeline_queue_batches
+                      << ",\"fixed_record_output\":" << fixed_record_output << "}";
+        manifest.open("F:\\TsetlinModels\\metadata\\run_" + std::to_string(seed) + ".jsonl", seed, settings_json.str());
+    }
+
+
+    for (int total_games_index = 0; total_games_index < 3; ++total_games_index) {
+        int total_games = total_games_list[total_games_index];
+
+        for (int board_dim = min_board_dim; board_dim <= max_board_dim; ++board_dim) {
+
+            for (int open_pos_index = 0; open_pos_index < 4; open_pos_index++) {
+                float n_open_pos = open_pos_list[open_pos_index];
+
+                for (int mbf_index = 0; mbf_index < 1; mbf_index++) {
+                    int moves_before_end = mbf_list[mbf_index];
+
+                    HexGame hg(board_dim);
+                    int open_pos = board_dim * board_dim * n_open_pos;
+                    uint64_t dataset_seed = config_seed(seed, board_dim, total_games, static_cast<int>(n_open_pos * 100), moves_before_end);
+
+                    // Measure time before saving the file
+                    auto start = std::chrono::high_resolution_clock::now();
+                    double start_cpu = process_cpu_seconds();
+                    MemoryReport memory;
+                    if (memory_accounting || memory_budget_bytes != 0) {
+                        memory.start();
+                    }
+
+                    bool file_created = true;  // Until one of the outputs fails to open
+                    std::string filename;
+
+                    // Create the filename ONCE per combination of board_dim, total_games, n_open_pos, etc.
+                    filename = "F:\\TsetlinModels\\data\\";
+                    filename += std::to_string(board_dim);
+                    filename += "x" + std::to_string(board_dim);
+                    filename += "_" + std::to_string(total_games);
+                    filename += "_" + std::to_string(static_cast<int>(n_open_pos * 100));
+                    filename += "_" + std::to_string(moves_before_end);
+                    filename += ".csv";
+                    std::cout << "Constructed filename: " << filename;
+                    std::string config_name = filename.substr(filename.find_last_of("\\") + 1);
+                    TraceSpan config_span("config", "sweep", total_games, config_name.c_str());
+
+                    // With splitting enabled every split gets its own dataset file instead
+                    std::vector<std::string> output_filenames;
+                    if (fixed_record_output) {
+                        output_filenames.push_back(filename.substr(0, filename.size() - 4) + ".hxb");
+                    } else if (split_output) {
+                        for (const auto& split_name : split_names) {
+                            output_filenames.push_back(filename.substr(0, filename.size() - 4) + "_" + split_name + ".csv");
+                        }
+                    } else {
+                        output_filenames.push_back(filename);
+                    }
+
+                    // A chunked dataset is complete once its manifest has been written
+                    bool chunked = !fixed_record_output && (chunk_records != 0 || chunk_bytes != 0);
+                    std::string existing = chunked ? chunk_manifest_filename(output_filenames[0]) : output_filenames[0];
+                    if (catalog.find(existing.substr(existing.find_last_of("\\") + 1)) != nullptr) {
+                        std::cout << " - File exists, skipping..." << std::endl;
+                        skipped_configs++;
+                        continue;  // Skip to the next iteration if file exists
+                    }
+
+                    if (fixed_record_output) {
+                        FixedRecordFile record_file;
+                        if (!record_file.open(output_filenames[0], board_dim, dataset_seed, total_games)) {
+                            continue;
+                        }
+                        StratumQuotas quotas(board_dim, open_pos, total_games, length_buckets, stratum_quotas);
+                        PlayoutSettings settings = {board_dim, dataset_seed, open_pos, moves_before_end, false,
+                                                    false, split_fractions, false, false};
+                        FixedRecordStats stats;
+                        uint64_t records = generate_fixed_records(settings, record_file, total_games, num_threads,
+                                                                  stratified_sampling ? &quotas : nullptr,
+                                                                  quota_give_up_playouts, stats);
+                        if (stats.gave_up) {
+                            std::cout << " - Giving up on unfilled strata" << std::endl;
+                            quotas.report_slow_strata(stats.playouts, true);
+                        }
+                        DatasetSketch sketch;
+                        for (uint64_t r = 0; r < records; ++r) {
+                            GameRecord game = {};
+                            decode_binary_record(record_file.slot(r), board_dim, game);
+                            sketch.add(game, board_dim);
+                        }
+                        if (!record_file.commit(records)) {
+                            continue;
                         }
 
-                        if (hg.number_of_open_positions >= open_pos) {
-                            // Valid game, remove last moves and store results
-                            std::vector<int> removed_moves = hg.remove_last_n_moves(moves_before_end);
-                            removed_moves_per_game.push_back(removed_moves);  // Track removed moves
+                        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+                        std::cout << " - " << records << " records from " << stats.playouts << " playouts ("
+                                  << stats.duplicates << " duplicates) in " << elapsed.count() << " s" << std::endl;
+                        if (memory_accounting) {
+                            memory.finish();
+                            memory.print(true);
+                        }
 
-                            std::pair<int, int> outcome = {starting_player, winner};
+                        auto [total_games, unique_games, wins_player_X, wins_player_O] = analyze_game_file({output_filenames[0]}, "binary");
+                        std::string metadata_filename = "F:\\TsetlinModels\\metadata\\metadata_" + output_filenames[0].substr(output_filenames[0].find_last_of("\\") + 1) + ".csv";
+                        std::cout << "Metadata filename: " << metadata_filename << std::endl;
+                        save_metadata_with_removed_moves(metadata_filename, output_filenames[0], board_dim, total_games, unique_games, wins_player_X, wins_player_O, "binary", {}, moves_before_end, dataset_seed);
+                        sketch.save(sketch_filename(metadata_filename));
+                        run_sketch.merge(sketch);
 
-                            std::string board_state = hg.board_to_string();
+                        ConfigReport report;
+                        report.dataset = output_filenames[0];
+                        report.board_dim = board_dim;
+                        report.total_games = total_games;
+                        report.open_percent = static_cast<int>(n_open_pos * 100);
+                        report.open_pos = open_pos;
+                        report.moves_before_end = moves_before_end;
+                        report.config_seed = dataset_seed;
+                        report.playouts = stats.playouts;
+                        report.accepted = records;
+                        report.records = records;
+                        report.too_few_open = stats.too_few_open;
+                        report.duplicates = stats.duplicates;
+                        report.quota_rejected = stats.quota_rejected;
+                        report.gave_up = stats.gave_up;
+                        report.wall_seconds = elapsed.count();
+                        report.cpu_seconds = process_cpu_seconds() - start_cpu;
+                        report.files = output_filenames;
+                        report.memory_accounting = memory_accounting;
+                        report.memory = memory;
+                        if (perf_counters) {
+                            report.perf_counters = true;
+                            report.perf = PerfCounters::collect();
+                            report_perf_counters(report.perf, stats.playouts);
+                        }
+                        manifest.add(report);
+                        continue;
+                    }
 
-                            // Ensure uniqueness
-                            if (unique_games.find(board_state) == unique_games.end()) {
-                                unique_games.insert(board_state); 
+                    std::vector<std::string> created_files;  // Outputs of this config, removed if it cannot start
+                    std::vector<GraphExporter> graph_exporters(output_filenames.size());
+                    if (export_graph) {
+                        std::string topology_filename = "F:\\TsetlinModels\\data\\graph_topology_" + std::to_string(board_dim) + "x" + std::to_string(board_dim) + ".bin";
+                        file_created = GraphExporter::write_topology(topology_filename, board_dim);
+                        for (size_t f = 0; f < output_filenames.size() && file_created; ++f) {
+                            std::string graph_filename = output_filenames[f].substr(0, output_filenames[f].size() - 4) + ".graph.bin";
+                            created_files.push_back(graph_filename);
+                            file_created = graph_exporters[f].open(graph_filename, board_dim, graph_group_ids);
+                        }
+                    }
 
-                                if (format == "coord") {
-                                    game_results_coord.emplace_back(hg.board_to_coord(), outcome);
-                                } else {
-                                    game_results_string.emplace_back(board_state, outcome);
-                                }
+                    std::vector<PatchExporter> patch_exporters(output_filenames.size());
+                    if (export_patches) {
+                        for (size_t f = 0; f < output_filenames.size() && file_created; ++f) {
+                            std::string patch_filename = output_filenames[f].substr(0, output_filenames[f].size() - 4) + ".patches.bin";
+                            created_files.push_back(patch_filename);
+                            file_created = patch_exporters[f].open(patch_filename, board_dim, patch_size, patch_stride, patch_padding);
+                        }
+                    }
 
-                                valid_games++;
+                    std::vector<PositionStreamExporter> position_exporters(output_filenames.size());
+                    if (export_positions) {
+                        for (size_t f = 0; f < output_filenames.size() && file_created; ++f) {
+                            std::string position_filename = output_filenames[f].substr(0, output_filenames[f].size() - 4) + ".positions.bin";
+                            created_files.push_back(position_filename);
+                            file_created = position_exporters[f].open(position_filename, board_dim, position_ply_stride);
+                        }
+                    }
 
+                    CorpusWriter corpus_writer;
+                    if (append_corpus && file_created) {
+                        file_created = corpus_writer.open(corpus_filename("F:\\TsetlinModels\\corpus\\", board_dim, ".games"), board_dim);
+                    }
 
+                    // The shared topology and corpus files are kept
+                    auto abandon_config = [&]() {
+                        for (size_t f = 0; f < output_filenames.size(); ++f) {
+                            graph_exporters[f].close();
+                            patch_exporters[f].close();
+                            position_exporters[f].close();
+                        }
+                        for (const auto& created : created_files) {
+                            std::error_code error;
+                            std::filesystem::remove(created, error);
+                        }
+                        std::cout << " - Could not create the outputs, skipping" << std::endl;
+                    };
+                    if (!file_created) {
+                        abandon_config();
+                        continue;
+                    }
 
-                                // Write results to file in batches
-                                if (format == "coord" && game_results_coord.size() >= batch_size) {
-                                    std::ofstream outfile(filename, std::ios::app);
-                                    for (const auto& result : game_results_coord) {
-                                        hg.write_coord_game_to_csv(outfile, result.first, result.second.first, result.second.second);
-                                    }
-                                    game_results_coord.clear();
-                                    outfile.close();
-                                    std::cout << " - Writing to " << board_dim << "x" << board_dim;
+                    // An interrupted chunked dataset continues from the last checkpoint of its journal, with the
+                    // kept rows' dedupe keys and sketch rebuilt from its chunks. Split outputs, exports and corpus
+                    // appends are not journaled, so configs writing them start over.
+                    bool resumable = chunked && !split_output && !export_graph && !export_patches && !export_positions &&
+                                     !append_corpus;
+                    std::string journal_filename = ResumeJournal::filename_for(output_filenames[0]);
+                    ResumeJournal::Checkpoint checkpoint;
+                    std::vector<std::vector<int>> resumed_removed_moves;
+                    std::unordered_set<std::string> resumed_keys;
+                    DatasetSketch resumed_sketch;
+                    uint64_t journal_seed = 0;
+                    bool resuming = resumable && ResumeJournal::load(journal_filename, resume_settings.str(), journal_seed,
+                                                                     checkpoint, resumed_removed_moves);
+                    if (resuming) {
+                        BoardSymmetry key_symmetry(board_dim);
+                        std::string base = output_filenames[0].substr(0, output_filenames[0].size() - 4);
+                        DatasetInfo info;
+                        uint64_t rows = 0;
+                        for (size_t c = 0; resuming && rows < checkpoint.records; ++c) {
+                            std::string part = ChunkedFileWriter::part_filename(base, c);
+                            resuming = std::filesystem::exists(part) && read_dataset(part, info, [&](const GameRecord &game) {
+                                PackedBoard key_board = augment_symmetries ? key_symmetry.canonical(game.board) : game.board;
+                                resumed_keys.insert(key_board.key());
+                                resumed_sketch.add(game, board_dim);
+                                return ++rows < checkpoint.records;
+                            });
+                        }
+                        if (!resuming) {
+                            std::cerr << "Cannot resume the chunks of " << output_filenames[0] << ", regenerating them" << std::endl;
+                        }
+                    }
+
+                    // Create and open the files once for writing header; they stay open until the config is done.
+                    // They come last, since an existing dataset CSV marks its config as done for later runs.
+                    std::vector<std::unique_ptr<FileWriter>> csv_writers;
+                    uint64_t expected_records = static_cast<uint64_t>(total_games) * (augment_symmetries ? SYMMETRY_COUNT : 1);
+                    for (size_t f = 0; f < output_filenames.size(); ++f) {
+                        double fraction = split_output ? split_fractions[f] : 1.0;
+                        // Splits are hash-assigned, so allow some slack over their expected share
+                        uint64_t preallocate = estimate_csv_bytes(format, board_dim, expected_records * std::min(1.0, fraction * 1.1));
+                        csv_writers.push_back(open_csv_writer(output_filenames[f], writer_backend, writer_direct_io, preallocate,
+                                                              format, board_dim, augment_symmetries, game_index_column,
+                                                              chunk_records, chunk_bytes, resuming ? checkpoint.records : 0));
+                        file_created = csv_writers.back() != nullptr;
+                        if (!file_created) {
+                            break;
+                        }
+                    }
+                    if (!file_created) {
+                        // Leave nothing behind that a later run could take for a finished dataset
+                        for (size_t f = 0; f < csv_writers.size(); ++f) {
+                            if (auto chunked_writer = dynamic_cast<ChunkedFileWriter*>(csv_writers[f].get())) {
+                                std::vector<std::string> chunks = chunked_writer->chunk_filenames();
+                                created_files.insert(created_files.end(), chunks.begin(), chunks.end());
+                            } else if (csv_writers[f]) {
+                                created_files.push_back(output_filenames[f]);
+                            }
+                            csv_writers[f].reset();  // Closes the file
+                        }
+                        abandon_config();
+                        continue;  // Skip this combination if the files could not be created
+                    }
 
-                                    // Measure time after writing
-                                    auto end = std::chrono::high_resolution_clock::now();
-                                    std::chrono::duration<double> elapsed = end - start;
+                    std::unordered_set<std::string> unique_games; // Set to track unique games
+                    std::unordered_set<uint64_t> unique_hashes;   // Replaces it once over the memory budget
+                    bool compact_keys = false;
+                    bool budget_exhausted = false;
+                    BoardSymmetry symmetry(board_dim);
+                    int valid_games = 0;
+                    int batch_size = 4096;  // Records per batch handed to the encode stage
+                    int empty_runs = 0;
+                    std::vector<GameRecord> game_results;
+                    std::vector<RemovedMovesLog> removed_moves_per_game(output_filenames.size());  // Per split
+                    StratumQuotas quotas(board_dim, open_pos, total_games, length_buckets, stratum_quotas);
+                    std::vector<DatasetSketch> sketches(output_filenames.size());  // Per split
+                    long long playouts = 0;
+                    long long playouts_since_accept = 0;
+                    long long records = 0;
+                    long long duplicates = 0;
+                    long long quota_rejected = 0;
+
+                    ChunkedFileWriter *chunked_writer = resumable ? static_cast<ChunkedFileWriter*>(csv_writers[0].get()) : nullptr;
+                    resuming = resuming && chunked_writer->resumed_records == checkpoint.records;
+                    if (resuming) {
+                        dataset_seed = journal_seed;
+                        unique_games = std::move(resumed_keys);
+                        sketches[0] = std::move(resumed_sketch);
+                        for (int s = 0; s < quotas.stratum_count() && s < static_cast<int>(checkpoint.quota_fill.size()); ++s) {
+                            quotas.filled[s].store(checkpoint.quota_fill[s]);
+                        }
+                        valid_games = checkpoint.valid_games;
+                        records = checkpoint.records;
+                        playouts = checkpoint.playouts;
+                        playouts_since_accept = checkpoint.playouts_since_accept;
+                        empty_runs = checkpoint.empty_runs;
+                        duplicates = checkpoint.duplicates;
+                        quota_rejected = checkpoint.quota_rejected;
+                        std::cout << " - Resuming after " << records << " rows";
+                    }
+                    ResumeJournal journal;
+                    if (resumable) {
+                        journal.open(journal_filename, resume_settings.str(), dataset_seed, resuming ? &checkpoint : nullptr,
+                                     resuming ? resumed_removed_moves : std::vector<std::vector<int>>());
+                    }
+                    if (resuming) {
+                        for (auto& moves : resumed_removed_moves) {
+                            removed_moves_per_game[0].push_back(std::move(moves));
+                        }
+                    }
+
+                    // Checkpoints wait for the chunks holding their rows to be closed
+                    std::deque<ResumeJournal::Checkpoint> pending_checkpoints;
+                    auto checkpoint_batch = [&]() {
+                        if (!journal.is_open()) {
+                            return;
+                        }
+                        ResumeJournal::Checkpoint batch;
+                        batch.records = records;
+                        batch.removed_moves = removed_moves_per_game[0].size();
+                        batch.valid_games = valid_games;
+                        batch.playouts = playouts;
+                        batch.playouts_since_accept = playouts_since_accept;
+                        batch.empty_runs = empty_runs;
+                        batch.duplicates = duplicates;
+                        batch.quota_rejected = quota_rejected;
+                        for (int s = 0; s < quotas.stratum_count(); ++s) {
+                            batch.quota_fill.push_back(quotas.filled[s].load());
+                        }
+                        pending_checkpoints.push_back(std::move(batch));
+                        uint64_t durable = chunked_writer->durable_records.load();
+                        if (pending_checkpoints.front().records > durable) {
+                            return;
+                        }
+                        while (pending_checkpoints.size() > 1 && pending_checkpoints[1].records <= durable) {
+                            pending_checkpoints.pop_front();
+                        }
+                        journal.checkpoint(pending_checkpoints.front());
+                        pending_checkpoints.pop_front();
+                    };
+
+                    // Process the games, committing them in game-index order
+                    PlayoutSettings settings = {board_dim, dataset_seed, open_pos, moves_before_end, augment_symmetries,
+                                                split_output, split_fractions, export_positions || append_corpus,
+                                                append_corpus};
+                    StageMetrics commit_metrics("commit", 1);
+                    auto pipeline_start = std::chrono::steady_clock::now();
+                    PlayoutGenerator generator(settings, num_threads, commit_metrics, 256, playouts);
+                    CsvOutputPipeline output(csv_writers, format, board_dim, augment_symmetries, game_index_column,
+                                             encode_threads, pipeline_queue_batches);
+                    bool gave_up = false;
+                    while (valid_games < total_games && !gave_up) {
+                        auto wait_start = std::chrono::steady_clock::now();
+                        std::vector<PlayoutResult> block = generator.next_block();
+                        uint64_t waited = nanoseconds_since(wait_start);
+                        commit_metrics.starved_ns += waited;
+                        TraceLog::record_wait("wait for playouts", "commit", wait_start, waited);
+                        for (PlayoutResult &result : block) {
+                            if (valid_games >= total_games) {
+                                break;
+                            }
+                            //std::cout << "Valid games: " << valid_games << " | Empty runs: " << empty_runs << std::endl;
+                            uint64_t game_index = result.game_index;
+                            int starting_player = result.starting_player;
+                            int winner = result.winner;
 
-                                    // Calculate hours, minutes, and seconds
-                                    int hours = static_cast<int>(elapsed.count() / 3600);
-                                    int minutes = static_cast<int>((elapsed.count() - (hours * 3600)) / 60);
-                                    int seconds = static_cast<int>(elapsed.count()) % 60;
+                            playouts++;
+                            playouts_since_accept++;
+                            if (stratified_sampling && playouts % quota_report_interval == 0) {
+                                quotas.report_slow_strata(playouts);
+                            }
+                            if (stratified_sampling && playouts_since_accept >= quota_give_up_playouts) {
+                                std::cout << " - Giving up on unfilled strata" << std::endl;
+                                quotas.report_slow_strata(playouts, true);
+                                gave_up = true;
+                                break;
+                            }
 
-                                    // Get the current system time
-                                    auto current_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-                                    std::tm* time_info = std::localtime(&current_time);
+                            if (append_corpus) {
+                                corpus_writer.append(result.moves, starting_player, winner);
+                            }
 
-                                    std::cout << " - " << std::setw(2) << std::setfill('0') << time_info->tm_hour
-                                              << ":" << std::setw(2) << std::setfill('0') << time_info->tm_min
-                                              << ":" << std::setw(2) << std::setfill('0') << time_info->tm_sec;
+                            if (!result.valid) {
+                                empty_runs++;
+                                continue;
+                            }
 
-                                    // Format and display elapsed time and current time
-                                    std::cout << " - " << std::setw(2) << std::setfill('0') << hours
-                                              << ":" << std::setw(2) << std::setfill('0') << minutes
-                                              << ":" << std::setw(2) << std::setfill('0') << seconds << std::endl;
+                            int stratum = -1;
+                            if (stratified_sampling) {
+                                stratum = quotas.stratum(winner, starting_player, result.game_length);
+                                if (!quotas.try_reserve(stratum)) {
+                                    quota_rejected++;
+                                    continue;  // Stratum already full
+                                }
+                            }
 
+                            // Valid game, store results
+                            int split = result.split;
+                            journal.removed(result.removed_moves);
+                            removed_moves_per_game[split].push_back(std::move(result.removed_moves));  // Track removed moves
 
+                            // Ensure uniqueness
+                            bool inserted;
+                            {
+                                // Inserts that grow the table rehash every key, a visible pause on large configs
+                                bool rehash = tracing_enabled.load(std::memory_order_relaxed) &&
+                                              unique_games.size() + 1 > unique_games.max_load_factor() * unique_games.bucket_count();
+                                auto insert_start = rehash ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+                                PerfRegion region(PERF_STAGE_DEDUP);
+                                inserted = compact_keys ? unique_hashes.insert(result.key_hash).second
+                                                        : unique_games.insert(std::move(result.board_key)).second;
+                                if (rehash) {
+                                    TraceLog::record("rehash", "dedup", insert_start, unique_games.bucket_count());
+                                }
+                            }
+                            if (!inserted) {
+                                duplicates++;
+                                if (stratified_sampling) {
+                                    quotas.release(stratum);
+                                }
+                                continue;
+                            }
 
-                                } else if (game_results_string.size() >= batch_size) {
-                                    std::ofstream outfile(filename, std::ios::app);
-                                    for (const auto& result : game_results_string) {
-                                        hg.write_game_to_csv(outfile, format, {result.first, result.second.second});  // Only winner passed
-                                        outfile << result.second.first << "," << result.second.second << "\n";  // Append starting player
+                            const PackedBoard &packed = result.board;
+                            size_t first_record = game_results.size();
+                            game_results.push_back({packed, starting_player, winner, SYMMETRY_IDENTITY, split, game_index});
+                            if (augment_symmetries) {
+                                for (int sym = 1; sym < SYMMETRY_COUNT; ++sym) {
+                                    PackedBoard variant = symmetry.apply(packed, sym);
+                                    // Skip variants that coincide with a board already emitted for this game
+                                    bool seen = false;
+                                    for (size_t r = first_record; r < game_results.size(); ++r) {
+                                        seen = seen || game_results[r].board == variant;
+                                    }
+                                    if (!seen) {
+                                        game_results.push_back({variant, BoardSymmetry::map_player(sym, starting_player),
+                                                                BoardSymmetry::map_player(sym, winner), sym, split, game_index});
                                     }
-                                    game_results_string.clear();
-                                    outfile.close();
-                                    std::cout << "2 Writing to " << board_dim << "x" << board_dim << std::endl;
                                 }
                             }
-                        } else {
-                            empty_runs++;
+
+                            if (export_graph || export_patches) {
+                                hg.unpack_board(packed);
+                            }
+                            if (export_graph) {
+                                graph_exporters[split].write(hg, starting_player, winner);
+                            }
+                            if (export_patches) {
+                                patch_exporters[split].write(hg, starting_player, winner);
+                            }
+                            if (export_positions) {
+                                position_exporters[split].write(result.moves, starting_player, winner);
+                            }
+
+                            for (size_t r = first_record; r < game_results.size(); ++r) {
+                                sketches[split].add(game_results[r], board_dim);
+                            }
+                            valid_games++;
+                            records += game_results.size() - first_record;
+                            playouts_since_accept = 0;
+
+                            // Over the memory budget, first keep 64-bit hashes instead of whole boards for
+                            // deduplication (collisions are negligible below billions of games), then spill
+                            // removed moves to disk; pending results are flushed early either way
+                            bool over_budget = memory_budget_bytes != 0 && valid_games % 1024 == 0 &&
+                                               current_rss_bytes() > memory_budget_bytes;
+                            if (over_budget && !compact_keys) {
+                                for (const auto& key : unique_games) {
+                                    PackedBoard key_board;
+                                    std::memcpy(&key_board, key.data(), sizeof(key_board));
+                                    unique_hashes.insert(key_board.hash());
+                                }
+                                std::unordered_set<std::string>().swap(unique_games);
+                                compact_keys = true;
+                                memory.compacted_keys = true;
+#ifdef __GLIBC__
+                                malloc_trim(0);
+#endif
+                                std::cout << " - Over the memory budget, deduplicating by board hash";
+                            } else if (over_budget && !memory.spilled_removed_moves) {
+                                for (size_t f = 0; f < removed_moves_per_game.size(); ++f) {
+                                    std::string spill_filename = (std::filesystem::temp_directory_path() /
+                                        ("removed_moves_" + std::to_string(dataset_seed) + "_" + std::to_string(f) + ".bin")).string();
+                                    removed_moves_per_game[f].start_spilling(spill_filename);
+                                }
+                                memory.spilled_removed_moves = true;
+                                std::cout << " - Over the memory budget, spilling removed moves to disk";
+                            } else if (over_budget && !budget_exhausted) {
+                                budget_exhausted = true;
+                                std::cout << " - Still over the memory budget with nothing left to compact or spill";
+                            }
+
+                            // Hand full batches to the encode stage
+                            if (valid_games % 1024 == 0 || static_cast<int>(game_results.size()) >= batch_size) {
+                                memory.unique_games_bytes = std::max(memory.unique_games_bytes, compact_keys
+                                    ? hash_set_bytes(unique_hashes, 0) : hash_set_bytes(unique_games, sizeof(PackedBoard) + 1));
+                                memory.game_results_bytes = std::max<uint64_t>(memory.game_results_bytes,
+                                                                               game_results.capacity() * sizeof(GameRecord));
+                                uint64_t removed_moves_bytes = 0;
+                                for (const auto& log : removed_moves_per_game) {
+                                    removed_moves_bytes += log.bytes();
+                                }
+                                memory.removed_moves_bytes = std::max(memory.removed_moves_bytes, removed_moves_bytes);
+                            }
+                            if (over_budget || static_cast<int>(game_results.size()) >= batch_size) {
+                                TraceSpan span("flush batch", "commit", game_results.size());
+                                commit_metrics.blocked_ns += output.submit(std::move(game_results));
+                                game_results.clear();
+                                checkpoint_batch();
+                            }
                         }
                     }
+                    generator.stop();
+                    corpus_writer.close();
 
                     // Write remaining results at the end
-                    if (!game_results_coord.empty() && format == "coord") {
-                        std::ofstream outfile(filename, std::ios::app);
-                        for (const auto& result : game_results_coord) {
-                            hg.write_coord_game_to_csv(outfile, result.first, result.second.first, result.second.second);
+                    if (!game_results.empty()) {
+                        TraceSpan span("flush batch", "commit", game_results.size());
+                        commit_metrics.blocked_ns += output.submit(std::move(game_results));
+                        game_results.clear();
+                    }
+                    commit_metrics.items = playouts;
+                    commit_metrics.busy_ns = nanoseconds_since(pipeline_start) - commit_metrics.starved_ns - commit_metrics.blocked_ns;
+                    auto drain_start = std::chrono::steady_clock::now();
+                    bool output_ok = output.finish();
+                    TraceLog::record("drain output", "commit", drain_start);
+                    if (!output_ok) {
+                        std::cerr << "Error writing the dataset files" << std::endl;
+                    }
+                    std::cout << " - Writing to " << board_dim << "x" << board_dim;
+
+                    // Measure time after writing
+                    auto end = std::chrono::high_resolution_clock::now();
+                    std::chrono::duration<double> elapsed = end - start;
+
+                    // Calculate hours, minutes, and seconds
+                    int hours = static_cast<int>(elapsed.count() / 3600);
+                    int minutes = static_cast<int>((elapsed.count() - (hours * 3600)) / 60);
+                    int seconds = static_cast<int>(elapsed.count()) % 60;
+
+                    // Get the current system time
+                    auto current_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                    std::tm* time_info = std::localtime(&current_time);
+
+                    std::cout << " - " << std::setw(2) << std::setfill('0') << time_info->tm_hour
+                              << ":" << std::setw(2) << std::setfill('0') << time_info->tm_min
+                              << ":" << std::setw(2) << std::setfill('0') << time_info->tm_sec;
+
+                    // Format and display elapsed time and current time
+                    std::cout << " - " << std::setw(2) << std::setfill('0') << hours
+                              << ":" << std::setw(2) << std::setfill('0') << minutes
+                              << ":" << std::setw(2) << std::setfill('0') << seconds << std::endl;
+                    if (report_pipeline_metrics) {
+                        report_stage_metrics({&generator.metrics, &commit_metrics, &output.encode_metrics, &output.write_metrics},
+                                             nanoseconds_since(pipeline_start) / 1e9);
+                    }
+                    if (memory_accounting || memory_budget_bytes != 0) {
+                        memory.finish();
+                        memory.print(memory_accounting);
+                    }
+
+                    for (size_t f = 0; f < output_filenames.size(); ++f) {
+                        if (!csv_writers[f]->close()) {
+                            std::cerr << "Error writing file: " << output_filenames[f] << std::endl;
+                            output_ok = false;
+                        }
+                        if (!graph_exporters[f].close()) {
+                            std::cerr << "Error writing file: " << graph_exporters[f].path << std::endl;
                         }
-                        outfile.close();
-                        std::cout << "3 Writing to " << board_dim << "x" << board_dim << std::endl;
-                    } else if (!game_results_string.empty()) {
-                        std::ofstream outfile(filename, std::ios::app);
-                        for (const auto& result : game_results_string) {
-                            hg.write_game_to_csv(outfile, format, {result.first, result.second.second});
-                            outfile << result.second.first << "," << result.second.second << "\n";
+                        if (!patch_exporters[f].close()) {
+                            std::cerr << "Error writing file: " << patch_exporters[f].path << std::endl;
                         }
-                        outfile.close();
-                        std::cout << "4 Writing to " << board_dim << "x" << board_dim << std::endl;
+                        if (!position_exporters[f].close()) {
+                            std::cerr << "Error writing file: " << position_exporters[f].path << std::endl;
+                        }
+                    }
+                    if (output_ok && journal.is_open()) {
+                        journal.remove();  // The manifest now marks the dataset as complete
+                    }
+
+                    ConfigReport report;
+                    report.dataset = filename;
+                    report.board_dim = board_dim;
+                    report.total_games = total_games;
+                    report.open_percent = static_cast<int>(n_open_pos * 100);
+                    report.open_pos = open_pos;
+                    report.moves_before_end = moves_before_end;
+                    report.config_seed = dataset_seed;
+                    report.playouts = playouts;
+                    report.accepted = valid_games;
+                    report.records = records;
+                    report.too_few_open = empty_runs;
+                    report.duplicates = duplicates;
+                    report.quota_rejected = quota_rejected;
+                    report.gave_up = gave_up;
+                    report.wall_seconds = elapsed.count();
+                    report.cpu_seconds = process_cpu_seconds() - start_cpu;
+                    report.stages = {&generator.metrics, &commit_metrics, &output.encode_metrics, &output.write_metrics};
+                    report.memory_accounting = memory_accounting || memory_budget_bytes != 0;
+                    report.memory = memory;
+                    if (perf_counters) {
+                        // The playout and output threads have exited and handed over their counts
+                        report.perf_counters = true;
+                        report.perf = PerfCounters::collect();
+                        report_perf_counters(report.perf, playouts);
                     }
 
-                    // Analyze the file to get metadata
-                    if (!filename.empty()) {
-                        auto [total_games, unique_games, wins_player_X, wins_player_O] = analyze_game_file(filename, format);
-                        std::string metadata_filename = "F:\\TsetlinModels\\metadata\\metadata_" + filename.substr(filename.find_last_of("\\") + 1);
+                    // Analyze the files to get metadata
+                    TraceSpan metadata_span("metadata", "sweep", output_filenames.size());
+                    for (size_t f = 0; f < output_filenames.size(); ++f) {
+                        std::string output_filename = output_filenames[f];
+                        std::vector<std::string> dataset_files = {output_filename};
+                        if (chunked) {
+                            dataset_files = static_cast<ChunkedFileWriter*>(csv_writers[f].get())->chunk_filenames();
+                            output_filename = chunk_manifest_filename(output_filename);
+                        }
+                        report.files.insert(report.files.end(), dataset_files.begin(), dataset_files.end());
+                        if (chunked) {
+                            report.files.push_back(output_filename);
+                        }
+                        auto [total_games, unique_games, wins_player_X, wins_player_O] = analyze_game_file(dataset_files, format);
+                        std::string metadata_filename = "F:\\TsetlinModels\\metadata\\metadata_" + output_filename.substr(output_filename.find_last_of("\\") + 1);
                         std::cout << "Metadata filename: " << metadata_filename << std::endl;
 
                         //std::string detailed_timestamp = generate_timestamp(true);
-                        save_metadata_with_removed_moves(metadata_filename, filename, board_dim, total_games, unique_games, wins_player_X, wins_player_O, format, removed_moves_per_game, moves_before_end);
+                        save_metadata_with_removed_moves(metadata_filename, output_filename, board_dim, total_games, unique_games, wins_player_X, wins_player_O, format, removed_moves_per_game[f], moves_before_end, dataset_seed);
+                        sketches[f].save(sketch_filename(metadata_filename));
+                        run_sketch.merge(sketches[f]);
                     }
+                    manifest.add(report);
                 }
             }
         }
     }
+    if (run_sketch.records > 0) {
+        run_sketch.save("F:\\TsetlinModels\\metadata\\run_" + std::to_string(seed) + ".sketch");
+    }
+    manifest.close(skipped_configs, run_sketch);
+    catalog_start = std::chrono::steady_clock::now();
+    update_catalog("F:\\TsetlinModels\\data\\", "F:\\TsetlinModels\\metadata\\",
+                   "F:\\TsetlinModels\\metadata\\catalog.index", num_threads, catalog, catalog_stats);
+    TraceLog::record("catalog", "sweep", catalog_start, catalog.entries.size());
+    if (trace_timeline) {
+        TraceLog::write("F:\\TsetlinModels\\metadata\\trace_" + std::to_string(seed) + ".json", seed);
+    }
     return 0;
 }